@@ -6,33 +6,258 @@
  *sda goes to PIN 21 and the sck goes to PIN 20*
  */ 
 #include "I2C.h"
-#include <avr/io.h>
-/**init for I2C scl set to 100000 kHz*/
+#include "prof.h"
+
+#define I2C_IDLE	0	/* bus released, TWI interrupt off */
+#define I2C_RUN		1	/* TWI_vect is working through the ring */
+#define I2C_HOLD	2	/* last descriptor had I2C_MORE and the ring ran dry, SCL is held low */
+
+#define I2C_GO		((1<<TWINT)|(1<<TWEN)|(1<<TWIE))
+
+static i2c_xfer_t i2c_queue[I2C_QUEUE_LEN];
+static volatile uint8_t i2c_head;	/* next free slot, written by I2C_Queue() */
+static volatile uint8_t i2c_tail;	/* descriptor being sent, written by the ISR */
+static volatile uint8_t i2c_state=I2C_IDLE;
+static uint16_t i2c_pos;			/* next byte inside the current descriptor */
+static uint8_t i2c_skip;			/* a transaction failed, drop its remaining descriptors */
+/* TWBR per profile, worked out by the compiler */
+static const uint8_t i2c_twbr[I2C_SPEED_COUNT] PROGMEM = {
+	I2C_TWBR(100000UL),
+	I2C_TWBR(400000UL),
+	I2C_TWBR(800000UL)
+};
+static const uint16_t i2c_khz[I2C_SPEED_COUNT] PROGMEM = {100,400,800};
+static i2c_speed_t i2c_speed;
+
+/**init for I2C, scl set to I2C_DEFAULT_SPEED. Switches on the display supply on PA0,
+* I2C_WaitReady() tells when the display has come up*/
 void I2C_Init()			/* I2C initialize function */
 {
-	 DDRA|=(1<<DDA0);
-	 PORTA|=(1<<PA0);
-	 _delay_ms(1000);
-	TWBR=18;
-	TWSR&=0xFC;
-	TWCR=0x05;
+	 hal_gpio_output(&DDRA,DDA0);
+	 hal_gpio_write(&PORTA,PA0,1);
+	I2C_SetSpeed(I2C_DEFAULT_SPEED);
+	hal_twi_ctrl(0x05);
+}
+
+/** Poll the address once per ms until the device acks, instead of a fixed power-up delay.
+* Returns the ms it took, timeout_ms if it never answered*/
+uint16_t I2C_WaitReady(char write_address, uint16_t timeout_ms)
+{
+	uint16_t ms;
+	uint8_t ack;
+
+	for(ms=0;ms<timeout_ms;ms++)
+	{
+		ack=I2C_Start(write_address)==1;
+		I2C_Stop();
+		if(ack) break;
+		_delay_ms(1);
+	}
+	return ms;
+}
+
+/** change the bus speed between transactions*/
+void I2C_SetSpeed(i2c_speed_t speed)
+{
+	I2C_Wait();
+	hal_twi_bitrate(pgm_read_byte(&i2c_twbr[speed]));
+	i2c_speed=speed;
+}
+
+i2c_speed_t I2C_GetSpeed(void)
+{
+	return i2c_speed;
+}
+
+uint16_t I2C_SpeedKHz(i2c_speed_t speed)
+{
+	return pgm_read_word(&i2c_khz[speed]);
+}
+
+/** Step the bus speed up until the device stops acking its address and a
+* control byte + command (0xE3 is NOP on the SSD1306), then settle on the
+* profile below that. Each speed is tried 4 times, and the bus is
+* left at the chosen speed.*/
+i2c_speed_t I2C_ProbeSpeed(char write_address)
+{
+	uint8_t speed,try,ok=0;
+	i2c_speed_t best=I2C_100KHZ;
+
+	for(speed=I2C_100KHZ;speed<I2C_SPEED_COUNT;speed++)
+	{
+		I2C_SetSpeed(speed);
+		for(try=0;try<4;try++)
+		{
+			ok=I2C_Start(write_address)==1 && I2C_Write(0x00)==0 && I2C_Write(0xE3)==0;
+			I2C_Stop();
+			if(!ok) break;
+		}
+		if(!ok) break;
+		best=speed;
+	}
+	I2C_SetSpeed(best);	/* one step below the first failure */
+	return best;
+}
+/** retire the descriptor at the tail and report its status*/
+static inline void i2c_complete(uint8_t status)
+{
+	i2c_xfer_t *x=&i2c_queue[i2c_tail];
+	if(x->done) *x->done=I2C_DONE|status;
+	if(x->callback) x->callback(status);
+	i2c_pos=0;
+	i2c_tail=(i2c_tail+1)&(I2C_QUEUE_LEN-1);
+}
+
+/** drop what is left of a failed transaction, then return 1 if there is a descriptor to start*/
+static inline uint8_t i2c_pending(void)
+{
+	while(i2c_skip && i2c_tail!=i2c_head)
+	{
+		i2c_skip=(i2c_queue[i2c_tail].flags&I2C_MORE)!=0;
+		i2c_complete(I2C_BUS_ERROR);
+	}
+	return !i2c_skip && i2c_tail!=i2c_head;
 }
+
+/** next byte of the current descriptor*/
+static inline uint8_t i2c_byte(const i2c_xfer_t *x, uint16_t i)
+{
+	if(x->flags&I2C_FILL) return x->src.bytes[0];
+	if(x->flags&I2C_INLINE) return x->src.bytes[i];
+	if(x->flags&I2C_PGM) return pgm_read_byte(x->src.ptr+i);
+	return x->src.ptr[i];
+}
+
+/** TWI state machine, p. 229 of the ATmega2560 data sheet (master transmitter status codes)*/
+static inline __attribute__((always_inline)) void i2c_service(void)
+{
+	i2c_xfer_t *x;
+	uint8_t status=hal_twi_status();
+
+	switch(status)
+	{
+		case 0x08:				/* START transmitted */
+		case 0x10:				/* repeated START transmitted */
+		hal_twi_put(i2c_queue[i2c_tail].addr);
+		hal_twi_ctrl(I2C_GO);
+		return;
+
+		case 0x18:				/* SLA+W transmitted & ack received */
+		case 0x28:				/* data transmitted & ack received */
+		for(;;)
+		{
+			x=&i2c_queue[i2c_tail];
+			if(i2c_pos<x->len){
+				hal_twi_put(i2c_byte(x,i2c_pos++));
+				hal_twi_ctrl(I2C_GO);
+				return;
+			}
+			status=x->flags;
+			i2c_complete(I2C_OK);
+			if(!(status&I2C_MORE)) break;
+			if(i2c_tail==i2c_head){	/* continuation not queued yet, hold the bus until it is */
+				hal_twi_ctrl(1<<TWEN);
+				i2c_state=I2C_HOLD;
+				return;
+			}
+		}
+		if(i2c_pending()){		/* STOP followed by START for the next transaction */
+			hal_twi_ctrl(I2C_GO|(1<<TWSTO)|(1<<TWSTA));
+		}else{
+			hal_twi_ctrl((1<<TWINT)|(1<<TWEN)|(1<<TWSTO));
+			i2c_state=I2C_IDLE;
+		}
+		return;
+
+		default:				/* NACK, arbitration lost or bus error */
+		i2c_skip=(i2c_queue[i2c_tail].flags&I2C_MORE)!=0;
+		i2c_complete(status==0x20?I2C_NACK_ADDR:status==0x30?I2C_NACK_DATA:I2C_BUS_ERROR);
+		hal_twi_ctrl((1<<TWINT)|(1<<TWEN)|(1<<TWSTO));
+		while(hal_twi_ctrl_get()&(1<<TWSTO)) hal_spin();	/* a few SCL periods, only on errors */
+		if(i2c_pending()){
+			hal_twi_ctrl(I2C_GO|(1<<TWSTA));
+		}else{
+			i2c_state=I2C_IDLE;
+		}
+		return;
+	}
+}
+
+ISR(TWI_vect)
+{
+	PROF_SCOPE(PROF_ISR_TWI);
+	i2c_service();
+}
+
+/** run the state machine by polling when called with interrupts disabled (e.g. before sei() in main)*/
+static void i2c_poll(void)
+{
+	hal_spin();
+	if(!hal_irq_enabled() && (hal_twi_ctrl_get()&((1<<TWINT)|(1<<TWIE)))==((1<<TWINT)|(1<<TWIE)))
+	i2c_service();
+}
+
+/** Copy a descriptor into the ring and start the bus if it is idle.
+* Blocks only while the ring is full.*/
+void I2C_Queue(const i2c_xfer_t *xfer)
+{
+	uint8_t next=(i2c_head+1)&(I2C_QUEUE_LEN-1);
+	if(next==i2c_tail){		/* ring full, wait for the ISR to retire one */
+		PROF_START(t);
+		while(next==i2c_tail)
+		i2c_poll();
+		PROF_STOP(PROF_I2C_WAIT,t);
+	}
+
+	i2c_queue[i2c_head]=*xfer;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		i2c_head=next;
+		if(i2c_state==I2C_HOLD){		/* TWINT is still set, re-enabling the interrupt continues the transaction */
+			i2c_state=I2C_RUN;
+			hal_twi_ctrl((1<<TWEN)|(1<<TWIE));
+		}else if(i2c_state==I2C_IDLE && i2c_pending()){
+			i2c_state=I2C_RUN;
+			hal_twi_ctrl(I2C_GO|(1<<TWSTA));
+		}
+	}
+}
+
+/** 1 while descriptors are queued or the bus is held*/
+uint8_t I2C_Busy(void)
+{
+	return i2c_state!=I2C_IDLE;
+}
+
+/** Wait for the ring to drain. Must not be called from an ISR.
+* A transaction left open with I2C_MORE never drains, so close it first.*/
+void I2C_Wait(void)
+{
+	if(i2c_state!=I2C_RUN) return;
+	PROF_START(t);
+	while(i2c_state==I2C_RUN)
+	i2c_poll();
+	PROF_STOP(PROF_I2C_WAIT,t);
+}
+
 /** I2C start function
+* Waits for queued transactions so the polled functions below own the bus
 * Return 0 to indicate start condition fail 
 * Return 1 to indicate ack received
 * Return 2 to indicate nack received*/
 uint8_t I2C_Start(char write_address)
 {   
 	uint8_t status;		/* Declare variable */
-	TWCR=(1<<TWSTA)|(1<<TWEN)|(1<<TWINT);;// /* Enable TWI, generate START */
-	while(!(TWCR&(1<<TWINT)));	/* Wait until TWI finish its current job */
-	status=TWSR&0xF8;		/* Read TWI status register */
+	I2C_Wait();
+	hal_twi_ctrl((1<<TWSTA)|(1<<TWEN)|(1<<TWINT));// /* Enable TWI, generate START */
+	while(!(hal_twi_ctrl_get()&(1<<TWINT))) hal_spin();	/* Wait until TWI finish its current job */
+	status=hal_twi_status();		/* Read TWI status register */
 	if(status!=0x08)		/* Check weather START transmitted or not? */
 	return 0;			/* Return 0 to indicate start condition fail */
-	TWDR=write_address;		/* Write SLA+W in TWI data register */
-	TWCR=(1<<TWEN)|(1<<TWINT);	/* Enable TWI & clear interrupt flag */
-	while(!(TWCR&(1<<TWINT)));	/* Wait until TWI finish its current job */
-	status=TWSR&0xF8;		/* Read TWI status register */
+	hal_twi_put(write_address);		/* Write SLA+W in TWI data register */
+	hal_twi_ctrl((1<<TWEN)|(1<<TWINT));	/* Enable TWI & clear interrupt flag */
+	while(!(hal_twi_ctrl_get()&(1<<TWINT))) hal_spin();	/* Wait until TWI finish its current job */
+	status=hal_twi_status();		/* Read TWI status register */
 	if(status==0x18)		/* Check for SLA+W transmitted &ack received */
 	return 1;			/* Return 1 to indicate ack received */
 	if(status==0x20){		/* Check for SLA+W transmitted &nack received */
@@ -47,15 +272,15 @@ uint8_t I2C_Start(char write_address)
 uint8_t I2C_Repeated_Start(char read_address)
 {
 	uint8_t status;		/* Declare variable */
-	TWCR=(1<<TWSTA)|(1<<TWEN)|(1<<TWINT);/* Enable TWI, generate start */
-	while(!(TWCR&(1<<TWINT)));	/* Wait until TWI finish its current job */
-	status=TWSR&0xF8;		/* Read TWI status register */
+	hal_twi_ctrl((1<<TWSTA)|(1<<TWEN)|(1<<TWINT));/* Enable TWI, generate start */
+	while(!(hal_twi_ctrl_get()&(1<<TWINT))) hal_spin();	/* Wait until TWI finish its current job */
+	status=hal_twi_status();		/* Read TWI status register */
 	if(status!=0x10)		/* Check for repeated start transmitted */
 	return 0;			/* Return 0 for repeated start condition fail */
-	TWDR=read_address;		/* Write SLA+R in TWI data register */
-	TWCR=(1<<TWEN)|(1<<TWINT);	/* Enable TWI and clear interrupt flag */
-	while(!(TWCR&(1<<TWINT)));	/* Wait until TWI finish its current job */
-	status=TWSR&0xF8;		/* Read TWI status register */
+	hal_twi_put(read_address);		/* Write SLA+R in TWI data register */
+	hal_twi_ctrl((1<<TWEN)|(1<<TWINT));	/* Enable TWI and clear interrupt flag */
+	while(!(hal_twi_ctrl_get()&(1<<TWINT))) hal_spin();	/* Wait until TWI finish its current job */
+	status=hal_twi_status();		/* Read TWI status register */
 	if(status==0x40)		/* Check for SLA+R transmitted &ack received */
 	return 1;			/* Return 1 to indicate ack received */
 	if(status==0x20)		/* Check for SLA+R transmitted &nack received */
@@ -66,10 +291,10 @@ uint8_t I2C_Repeated_Start(char read_address)
 uint8_t I2C_Write(char data)	/* I2C write function */
 {
 	uint8_t status;		/* Declare variable */
-	TWDR=data;			/* Copy data in TWI data register */
-	TWCR=(1<<TWEN)|(1<<TWINT);	/* Enable TWI and clear interrupt flag */
-	while(!(TWCR&(1<<TWINT)));	/* Wait until TWI finish its current job */
-	status=TWSR&0xF8;		/* Read TWI status register */
+	hal_twi_put(data);			/* Copy data in TWI data register */
+	hal_twi_ctrl((1<<TWEN)|(1<<TWINT));	/* Enable TWI and clear interrupt flag */
+	while(!(hal_twi_ctrl_get()&(1<<TWINT))) hal_spin();	/* Wait until TWI finish its current job */
+	status=hal_twi_status();		/* Read TWI status register */
 	if(status==0x28)		/* Check for data transmitted &ack received */
 	return 0;			/* Return 0 to indicate ack received */
 	if(status==0x30)		/* Check for data transmitted &nack received */
@@ -79,19 +304,19 @@ uint8_t I2C_Write(char data)	/* I2C write function */
 }
 char I2C_Read_Ack()		/* I2C read ack function */
 {
-	TWCR=(1<<TWEN)|(1<<TWINT)|(1<<TWEA); /* Enable TWI, generation of ack */
-	while(!(TWCR&(1<<TWINT)));	/* Wait until TWI finish its current job */
-	return TWDR;			/* Return received data */
+	hal_twi_ctrl((1<<TWEN)|(1<<TWINT)|(1<<TWEA)); /* Enable TWI, generation of ack */
+	while(!(hal_twi_ctrl_get()&(1<<TWINT))) hal_spin();	/* Wait until TWI finish its current job */
+	return hal_twi_get();			/* Return received data */
 }
 char I2C_Read_Nack()		/* I2C read nack function */
 {
-	TWCR=(1<<TWEN)|(1<<TWINT);	/* Enable TWI and clear interrupt flag */
-	while(!(TWCR&(1<<TWINT)));	/* Wait until TWI finish its current job */
-	return TWDR;		/* Return received data */
+	hal_twi_ctrl((1<<TWEN)|(1<<TWINT));	/* Enable TWI and clear interrupt flag */
+	while(!(hal_twi_ctrl_get()&(1<<TWINT))) hal_spin();	/* Wait until TWI finish its current job */
+	return hal_twi_get();		/* Return received data */
 }
 
 void I2C_Stop()			/* I2C stop function */
 {
-	TWCR=(1<<TWSTO)|(1<<TWINT)|(1<<TWEN);/* Enable TWI, generate stop */
-	while(TWCR&(1<<TWSTO));	/* Wait until stop condition execution */
+	hal_twi_ctrl((1<<TWSTO)|(1<<TWINT)|(1<<TWEN));/* Enable TWI, generate stop */
+	while(hal_twi_ctrl_get()&(1<<TWSTO)) hal_spin();	/* Wait until stop condition execution */
 }
\ No newline at end of file
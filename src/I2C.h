@@ -8,17 +8,70 @@
 
 #ifndef I2C_H_
 #define I2C_H_
-#define SCL_CLK 100000
-#define F_CPU 16000000UL
 
 char write_address;
 
-#include <util/delay.h>
+#include "hal.h"
 
-#define BITRATE(TWSR)	((F_CPU/SCL_CLK)-16)/(2*pow(4,(TWSR&((1<<TWPS0)|(1<<TWPS1)))))
+/** SCL = F_CPU/(16+2*TWBR*prescaler) p. 248, all profiles use prescaler 1 (TWPS=0)*/
+#define I2C_TWBR(scl)	((F_CPU/(scl)-16)/2)
+#if F_CPU/800000UL < 16
+#error "F_CPU too low for the 800 kHz I2C profile"
+#endif
 char read_addres;
 
+/** bus speed profiles, the SSD1306 is specified for 400 kHz and most modules run faster*/
+typedef enum {
+	I2C_100KHZ,			/* standard mode */
+	I2C_400KHZ,			/* fast mode */
+	I2C_800KHZ,			/* beyond spec, use I2C_ProbeSpeed() before relying on it */
+	I2C_SPEED_COUNT
+} i2c_speed_t;
+#define I2C_DEFAULT_SPEED	I2C_400KHZ
+
+/** Interrupt driven transactions.
+* A transaction is one or more descriptors in the ring, each with I2C_MORE set except the last.
+* TWI_vect sends START, SLA+W, the bytes of every descriptor and the STOP, so I2C_Queue()
+* returns as soon as the descriptor is copied and only blocks while the ring is full.*/
+#define I2C_QUEUE_LEN	16		/* descriptors in the ring, power of 2 */
+#define I2C_INLINE_MAX	8		/* bytes that fit inside a descriptor */
+
+/* descriptor flags */
+#define I2C_INLINE	0x01		/* bytes are in src.bytes[] */
+#define I2C_PGM		0x02		/* src.ptr points to flash */
+#define I2C_FILL	0x04		/* send src.bytes[0] len times */
+#define I2C_MORE	0x08		/* no STOP, the next descriptor continues this transaction */
+
+/* completion status, written to *done together with I2C_DONE */
+#define I2C_OK			0x00
+#define I2C_NACK_ADDR	0x01
+#define I2C_NACK_DATA	0x02
+#define I2C_BUS_ERROR	0x03
+#define I2C_DONE		0x80
+
+typedef void (*i2c_callback_t)(uint8_t status);
+
+typedef struct {
+	uint8_t addr;				/* SLA+W, only used by the first descriptor of a transaction */
+	uint8_t flags;
+	uint16_t len;
+	union {
+		const uint8_t *ptr;		/* RAM (must stay valid until sent) or flash with I2C_PGM */
+		uint8_t bytes[I2C_INLINE_MAX];
+	} src;
+	volatile uint8_t *done;		/* optional, set to I2C_DONE|status when this descriptor is finished */
+	i2c_callback_t callback;	/* optional, called from the ISR with the status */
+} i2c_xfer_t;
+
 void I2C_Init()	;
+uint16_t I2C_WaitReady(char write_address, uint16_t timeout_ms);	/* ack polling after power up, returns ms */
+void I2C_SetSpeed(i2c_speed_t speed);	/* waits for queued transactions, then reprograms TWBR */
+i2c_speed_t I2C_GetSpeed(void);
+uint16_t I2C_SpeedKHz(i2c_speed_t speed);
+i2c_speed_t I2C_ProbeSpeed(char write_address);	/* fastest profile the device still acks, minus one step */
+void I2C_Queue(const i2c_xfer_t *xfer);	/* copy a descriptor into the ring */
+uint8_t I2C_Busy(void);			/* 1 while descriptors are queued or being sent */
+void I2C_Wait(void);			/* block until the ring is empty and the bus is released */
 uint8_t I2C_Start(char write_address);/* I2C start function */
 uint8_t I2C_Repeated_Start(char read_address); /* I2C repeated start function */
 uint8_t I2C_Write(char data);	/* I2C write function */
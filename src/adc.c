@@ -0,0 +1,56 @@
+/*
+ * adc.c
+ * ADC setup and scan list, the per conversion code is inline in adc.h
+ */
+#include "adc.h"
+
+adc_scan_t adc_scan={ {0}, 1, 0, 0 };
+volatile uint16_t adc_result[ADC_CHANNELS];
+volatile uint8_t adc_quiet;
+
+/** Free running on the Timer1 overflow: no interrupt is needed to start a
+* conversion. 13.5 ADC clocks at 125 kHz (1728 CPU cycles) fit in the
+* 2046 cycle PWM period.*/
+void adc_init(void)
+{
+	hal_adc_init(adc_scan.list[0]);	/* prescaler 128 -> 125 kHz, trigger source Timer1 overflow */
+}
+
+/** Replace the scan list, the first entry drives the PWM. The conversion that
+* may be running was set up for the old list, so its result is dropped.*/
+uint8_t adc_set_scan(const uint8_t *ch, uint8_t n)
+{
+	uint8_t i;
+
+	if(n<1 || n>ADC_SCAN_MAX) return 1;
+	for(i=0;i<n;i++)
+	{
+		if(ch[i]>=ADC_CHANNELS) return 1;
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for(i=0;i<n;i++) adc_scan.list[i]=ch[i];
+		adc_scan.n=n;
+		adc_scan.pos=0;
+		adc_scan.skip=1;
+		hal_adc_select(ch[0]);
+	}
+	return 0;
+}
+
+/** Read ch with the CPU asleep. The PWM misses one update and Timer1 stands still
+* for the conversion, a UART byte arriving meanwhile can be lost and one being sent
+* gets a stretched bit, so flush the UART first.*/
+uint16_t adc_read_quiet(uint8_t ch)
+{
+	uint16_t v;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		adc_quiet=1;
+		v=hal_adc_read_nr(ch);
+		adc_quiet=0;
+	}
+	return v;
+}
@@ -0,0 +1,63 @@
+/*
+ * adc.h
+ * ADC auto-triggered by the Timer1 overflow, scanning a list of channels
+ *
+ * each Timer1 overflow (once per PWM period) starts one conversion by hardware,
+ * ISR(ADC_vect) only collects the result: call adc_scan_step() first, it returns
+ * the channel of the finished conversion and programs the next one in the list.
+ * the first channel in the list is the one that drives the PWM.
+ */
+
+
+#ifndef ADC_H_
+#define ADC_H_
+
+#include "hal.h"
+
+#ifdef MUX5
+#define ADC_CHANNELS	16		/* ATmega2560, channels 8-15 need MUX5 */
+#else
+#define ADC_CHANNELS	8
+#endif
+#define ADC_SCAN_MAX	8		/* entries in the scan list */
+#define ADC_SKIP		0xFF	/* adc_scan_step(): result belongs to the old list, drop it */
+
+typedef struct {
+	uint8_t list[ADC_SCAN_MAX];
+	uint8_t n;
+	uint8_t pos;			/* entry being converted */
+	uint8_t skip;			/* 1 = conversion in flight was set up by the previous list */
+} adc_scan_t;
+
+extern adc_scan_t adc_scan;
+extern volatile uint16_t adc_result[ADC_CHANNELS];	/* last raw result per channel */
+extern volatile uint8_t adc_quiet;					/* adc_read_quiet() owns the ADC */
+
+void adc_init(void);							/* scan list { 0 } */
+uint8_t adc_set_scan(const uint8_t *ch, uint8_t n);	/* 0 or 1 on a bad list */
+uint16_t adc_read_quiet(uint8_t ch);			/* one conversion in ADC noise reduction sleep */
+
+/** For ISR(ADC_vect): returns the channel of the result in ADC (or ADC_SKIP)
+* and moves on to the next channel. ADMUX is updated before TOV1 is cleared,
+* as the datasheet requires, and clearing TOV1 arms the next trigger edge
+* now that no overflow ISR clears it.*/
+static inline uint8_t adc_scan_step(void)
+{
+	uint8_t ch=adc_scan.list[adc_scan.pos];
+
+	if(adc_quiet){				/* woke adc_read_quiet(), the scan did not move */
+		hal_pwm_clear_ovf();
+		return ADC_SKIP;
+	}
+	if(++adc_scan.pos>=adc_scan.n) adc_scan.pos=0;
+	if(adc_scan.n>1) hal_adc_select(adc_scan.list[adc_scan.pos]);
+	hal_pwm_clear_ovf();
+
+	if(adc_scan.skip){
+		adc_scan.skip=0;
+		return ADC_SKIP;
+	}
+	return ch;
+}
+
+#endif /* ADC_H_ */
@@ -0,0 +1,28 @@
+/*
+ * adc_filter.c
+ * configuration of the ADC filter stage, the per sample code is inline in adc_filter.h
+ */
+#include "adc_filter.h"
+#include "hal.h"
+
+adc_filter_t adc_filter;
+
+/** Switch filter while the ADC keeps running. The state is reset inside one
+* atomic block, so the ISR sees either the old or the new filter, never a mix.
+* Returns 1 without changing anything if k is out of range for the mode.*/
+uint8_t filter_set(uint8_t mode, uint8_t k, uint8_t median)
+{
+	if(mode==FILTER_OVERSAMPLE && (k<1 || k>3)) return 1;
+	if(mode==FILTER_IIR && (k<1 || k>6)) return 1;
+	if(mode>FILTER_IIR) return 1;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		adc_filter.mode=mode;
+		adc_filter.k=k;
+		adc_filter.median=median?2:0;
+		adc_filter.count=0;
+		adc_filter.acc=0;
+	}
+	return 0;
+}
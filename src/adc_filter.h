@@ -0,0 +1,92 @@
+/*
+ * adc_filter.h
+ * filtering stage between the ADC read and the PWM clamp in ISR(ADC_vect)
+ *
+ * optional median-of-3 spike rejector, followed by one of
+ *   FILTER_OFF        raw sample
+ *   FILTER_OVERSAMPLE sum of 4^k samples (k = 1..3), one output per block,
+ *                     11 bits for k = 1, 12 bits for k >= 2
+ *   FILTER_IIR        single pole low pass y += (x - y) / 2^k (k = 1..6), fixed point
+ * all results are scaled to 12 bits (0..4092) so the caller handles one format.
+ *
+ * cycle budget at 16 MHz: "adc_filter_cycles" in the simavr bench (tools/simavr_bench)
+ * gives ADC_vect per FILT: mode, the filter cost is the difference to "OFF". the
+ * ISR must stay well inside the 2046 cycle Timer1 period that paces the ADC.
+ * no multiply or divide; variable shifts are loops of 4 cycles per bit.
+ */
+
+
+#ifndef ADC_FILTER_H_
+#define ADC_FILTER_H_
+
+#include <stdint.h>
+
+#define FILTER_OFF			0
+#define FILTER_OVERSAMPLE	1
+#define FILTER_IIR			2
+
+typedef struct {
+	uint8_t mode;			/* FILTER_* */
+	uint8_t k;				/* oversample 4^k / IIR 1/2^k */
+	uint8_t median;			/* 1 = median-of-3 in front, 2 = median with empty history */
+	uint8_t count;			/* samples in the current block, 0 = restart the IIR */
+	uint16_t acc;			/* oversample sum, or IIR state scaled by 2^k */
+	uint16_t hist[2];		/* last two raw samples for the median */
+} adc_filter_t;
+
+extern adc_filter_t adc_filter;
+
+uint8_t filter_set(uint8_t mode, uint8_t k, uint8_t median);	/* 0 or 1 if k is out of range */
+
+/** median of three, two compare and swaps*/
+static inline uint16_t filter_median3(uint16_t a, uint16_t b, uint16_t c)
+{
+	if(a>b){ uint16_t t=a; a=b; b=t; }
+	if(b>c) b=c;
+	return a>b?a:b;
+}
+
+/** Run one raw 10-bit sample through the filter, for ISR(ADC_vect).
+* Returns 1 and a 12-bit value in *out when there is a new output,
+* 0 while an oversampling block is still filling.*/
+static inline uint8_t filter_run(uint16_t x, uint16_t *out)
+{
+	adc_filter_t *f=&adc_filter;
+
+	if(f->median){
+		if(f->median==2){			/* fill the history with the first sample */
+			f->hist[0]=f->hist[1]=x;
+			f->median=1;
+		}
+		uint16_t m=filter_median3(x,f->hist[0],f->hist[1]);
+		f->hist[1]=f->hist[0];
+		f->hist[0]=x;
+		x=m;
+	}
+
+	switch(f->mode)
+	{
+		case FILTER_OVERSAMPLE:
+		f->acc+=x;
+		if(++f->count<(uint8_t)(1<<(2*f->k))) return 0;
+		*out=f->acc>>(2*(f->k-1));	/* 4^k samples carry k extra bits */
+		f->acc=0;
+		f->count=0;
+		return 1;
+
+		case FILTER_IIR:
+		if(!f->count){				/* start at the input instead of ramping up from 0 */
+			f->acc=x<<f->k;
+			f->count=1;
+		}
+		f->acc+=x-(f->acc>>f->k);
+		*out=f->k>=2?f->acc>>(f->k-2):f->acc<<1;
+		return 1;
+
+		default:
+		*out=x<<2;
+		return 1;
+	}
+}
+
+#endif /* ADC_FILTER_H_ */
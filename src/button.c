@@ -0,0 +1,79 @@
+/*
+ * button.c
+ * shift register debouncer and event queue, button_tick() is the only producer
+ * (tick interrupt) and button_event() the only consumer (main loop).
+ */
+#include "hal.h"
+#include "button.h"
+
+#define BUTTON_LONG_N		(BUTTON_LONG_MS/BUTTON_SAMPLE_MS)		/* in samples */
+#define BUTTON_DOUBLE_N	(BUTTON_DOUBLE_MS/BUTTON_SAMPLE_MS)
+
+static volatile uint8_t button_queue[BUTTON_QUEUE_LEN];
+static volatile uint8_t button_head;	/* written by the tick only */
+static volatile uint8_t button_tail;	/* written by the main loop only */
+
+static uint8_t button_div;				/* ticks since the last sample */
+static uint8_t button_history;			/* last 8 samples, 1 = pressed */
+static volatile uint8_t button_level;	/* debounced */
+static uint16_t button_held=BUTTON_LONG_N;		/* samples since the press, stops at BUTTON_LONG_N */
+static uint8_t button_gap=BUTTON_DOUBLE_N;		/* samples since the release, stops at BUTTON_DOUBLE_N */
+static uint8_t button_second;			/* this press made a BUTTON_DOUBLE */
+
+void button_init(void)
+{
+	hal_gpio_pullup(&PORTE,PE4);
+}
+
+/** a full queue drops the new event*/
+static void button_put(uint8_t event)
+{
+	uint8_t next=(button_head+1)&(BUTTON_QUEUE_LEN-1);
+	if(next==button_tail) return;
+	button_queue[button_head]=event;
+	button_head=next;
+}
+
+void button_tick(void)
+{
+	if(++button_div<BUTTON_SAMPLE_MS) return;
+	button_div=0;
+
+	button_history=(button_history<<1)|!hal_gpio_read(&PINE,PE4);
+	if(!button_level){
+		if(button_history==0xFF){
+			button_level=1;
+			button_held=0;
+			button_put(BUTTON_PRESS);
+			button_second=button_gap<BUTTON_DOUBLE_N;
+			if(button_second) button_put(BUTTON_DOUBLE);
+		}else if(button_gap<BUTTON_DOUBLE_N) button_gap++;
+	}else{
+		if(button_history==0x00){
+			button_level=0;
+			button_gap=button_second?BUTTON_DOUBLE_N:0;	/* a third press starts over */
+			button_put(BUTTON_RELEASE);
+		}else if(button_held<BUTTON_LONG_N && ++button_held==BUTTON_LONG_N) button_put(BUTTON_LONG);
+	}
+}
+
+button_event_t button_event(void)
+{
+	uint8_t tail=button_tail;
+	button_event_t event;
+
+	if(tail==button_head) return BUTTON_NONE;
+	event=button_queue[tail];
+	button_tail=(tail+1)&(BUTTON_QUEUE_LEN-1);
+	return event;
+}
+
+uint8_t button_pending(void)
+{
+	return (button_head-button_tail)&(BUTTON_QUEUE_LEN-1);
+}
+
+uint8_t button_down(void)
+{
+	return button_level;
+}
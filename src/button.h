@@ -0,0 +1,34 @@
+/*
+ * button.h
+ * push button on PE4 (to GND, internal pull-up), debounced from the 1 ms system tick.
+ * the tick shifts one sample every BUTTON_SAMPLE_MS into an 8 bit history, the level
+ * only changes once all 8 samples agree. changes come out of a queue as events, so
+ * nothing in the main loop ever waits for the contacts to settle.
+ */
+
+
+#ifndef BUTTON_H_
+#define BUTTON_H_
+
+#include <stdint.h>
+
+#define BUTTON_SAMPLE_MS	2		/* 8 samples -> 16 ms of steady level */
+#define BUTTON_LONG_MS		800		/* held this long: BUTTON_LONG, once per press */
+#define BUTTON_DOUBLE_MS	300		/* release to the next press for BUTTON_DOUBLE */
+#define BUTTON_QUEUE_LEN	8		/* events, power of 2 */
+
+typedef enum {
+	BUTTON_NONE,
+	BUTTON_PRESS,
+	BUTTON_RELEASE,
+	BUTTON_LONG,				/* while still held, BUTTON_RELEASE follows */
+	BUTTON_DOUBLE				/* right after the BUTTON_PRESS of the second press */
+} button_event_t;
+
+void button_init(void);			/* pull-up on, starts released */
+void button_tick(void);			/* from the 1 ms tick interrupt */
+button_event_t button_event(void);	/* next event, BUTTON_NONE when the queue is empty */
+uint8_t button_pending(void);	/* events waiting */
+uint8_t button_down(void);		/* debounced level, 1 while pressed */
+
+#endif /* BUTTON_H_ */
@@ -0,0 +1,107 @@
+/*
+ * capture.c
+ * arming and dumping the capture ring, recording is inline in capture.h
+ */
+#include "capture.h"
+#include "uart.h"
+#include "proto.h"
+
+capture_t capture;
+
+/* dump in progress */
+static uint16_t dump_left;		/* records still to queue */
+static uint16_t dump_i;			/* next record */
+static uint8_t dump_crc;
+static uint8_t dump_phase;		/* 0 header, 1 records, 2 CRC, 3 draining */
+
+/** Start recording. pre records from before the trigger are kept, the
+* remaining CAPTURE_SIZE - pre come after it (the trigger record included).
+* level is a raw ADC value or OCR1A, both 0..1023.*/
+uint8_t capture_arm(uint8_t trig, uint16_t level, uint8_t decim, uint16_t pre)
+{
+	if(trig>CAP_TRIG_OUT || level>1023 || !decim || pre>=CAPTURE_SIZE) return 1;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		capture.trig=trig;
+		capture.level=level;
+		capture.decim=decim;
+		capture.div=decim-1;		/* record the first sample */
+		capture.prev=trig==CAP_TRIG_FALL?0:0xFFFF;	/* no edge on the first record */
+		capture.time=0;
+		capture.pre=pre;
+		capture.left=CAPTURE_SIZE-pre;
+		capture.head=0;
+		capture.count=0;
+		capture.state=CAP_ARMED;
+	}
+	return 0;
+}
+
+void capture_stop(void)
+{
+	capture.state=CAP_IDLE;
+}
+
+static uint8_t capture_put(uint8_t crc, const uint8_t *data, uint8_t len)
+{
+	uint8_t sent=0;
+
+	while(sent<len)			/* whatever the tx policy, everything goes out */
+	sent+=uart_write((const char *)data+sent,len-sent);
+	return proto_crc8(crc,data,len);
+}
+
+/** Send the finished capture, one step per call from the scheduler. The baud
+* rate switch is announced at the normal rate, the host gets CAPTURE_WAIT_MS to
+* follow before the data starts. Each step queues only what fits in the TX ring,
+* so the 522 bytes of a full ring take about 21 ms without holding the CPU.
+* Records are packed from 6 to 4 bytes here, not in the ISR.*/
+uint8_t capture_dump(unsigned int ubrr_normal)
+{
+	if(capture.state==CAP_DONE)
+	{
+		uart_puts_P(PSTR("CAP: dump at 250000 baud in 100 ms\r\n"));	/* CAPTURE_BAUD, CAPTURE_WAIT_MS */
+		dump_left=capture.count;
+		dump_i=(capture.head-dump_left)&(CAPTURE_SIZE-1);	/* oldest record */
+		dump_phase=0;
+		capture.state=CAP_DUMP;
+		return CAPTURE_WAIT_MS;
+	}
+	if(capture.state!=CAP_DUMP) return 0;
+
+	if(dump_phase==0)
+	{
+		uint8_t hdr[9]={ 'C','A','P', dump_left&0xFF, dump_left>>8, capture.pre&0xFF, capture.pre>>8,
+			capture.decim, capture.trig };
+		uart_set_ubrr(F_CPU/8/CAPTURE_BAUD-1);	/* the announcement is out long ago */
+		dump_crc=capture_put(0,hdr,sizeof(hdr));
+		dump_phase=1;
+	}
+	while(dump_phase==1 && uart_tx_free()>=4)
+	{
+		const capture_rec_t *r=&capture.rec[dump_i];
+		uint8_t b[4];
+		if(!dump_left){
+			dump_phase=2;
+			break;
+		}
+		b[0]=r->raw;
+		b[1]=((r->raw>>8)&0x03)|(r->out<<2);
+		b[2]=((r->out>>6)&0x0F)|(r->time<<4);
+		b[3]=r->time>>4;
+		dump_crc=capture_put(dump_crc,b,4);
+		dump_i=(dump_i+1)&(CAPTURE_SIZE-1);
+		dump_left--;
+	}
+	if(dump_phase==2 && uart_tx_free())
+	{
+		capture_put(dump_crc,&dump_crc,1);
+		dump_phase=3;
+	}
+	if(dump_phase<3 || uart_tx_free()<UART_TX_SIZE-1) return CAPTURE_STEP_MS;
+
+	uart_set_ubrr(ubrr_normal);		/* waits for the last byte only */
+	capture.state=CAP_IDLE;
+	return 0;
+}
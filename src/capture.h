@@ -0,0 +1,107 @@
+/*
+ * capture.h
+ * records raw ADC, OCR1A and a timestamp from ISR(ADC_vect) into a ring,
+ * stops a set number of records after a trigger and is then dumped over the UART
+ *
+ * dump (capture_dump), sent at CAPTURE_BAUD after a text announcement at the normal rate:
+ *   'C' 'A' 'P' | count u16 | pre u16 | decimation u8 | trigger u8 | records... | CRC-8
+ * pre is the number of records before the trigger record in this dump
+ * every record is 4 bytes, little endian bit fields:
+ *   bits 0-9 raw ADC, bits 10-19 OCR1A, bits 20-31 timestamp (mod 4096)
+ * the dump runs in steps from the scheduler, see capture_dump(). other UART output has
+ * to wait while the state is CAP_DUMP, it would end up in the binary data.
+ * the timestamp counts control channel conversions, one per PWM period (127.9 us)
+ * times the length of the scan list. the CRC is proto_crc8() over everything before it.
+ */
+
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include "hal.h"
+
+#if RAMEND >= 0x1000
+#define CAPTURE_SIZE	128		/* records, power of 2, 768 bytes */
+#else
+#define CAPTURE_SIZE	32
+#endif
+#define CAPTURE_BAUD	250000UL	/* exact at 16 MHz with U2X (UBRR 7) */
+#define CAPTURE_WAIT_MS	100			/* from the announcement until the baud rate switch */
+#define CAPTURE_STEP_MS	2			/* between dump steps, 50 bytes at CAPTURE_BAUD */
+
+/* states */
+#define CAP_IDLE		0
+#define CAP_DONE		1		/* full, waiting for the dump */
+#define CAP_DUMP		2		/* being sent, the UART runs at CAPTURE_BAUD */
+#define CAP_ARMED		3		/* recording, waiting for the trigger */
+#define CAP_TRIGGERED	4		/* recording the rest after the trigger */
+
+/* triggers */
+#define CAP_TRIG_NOW	0		/* trigger on the first record */
+#define CAP_TRIG_RISE	1		/* raw ADC crosses the level upwards */
+#define CAP_TRIG_FALL	2		/* raw ADC crosses the level downwards */
+#define CAP_TRIG_OUT	3		/* OCR1A reaches the level, e.g. max_pwm */
+
+typedef struct {
+	uint16_t raw;
+	uint16_t out;
+	uint16_t time;
+} capture_rec_t;
+
+typedef struct {
+	volatile uint8_t state;
+	uint8_t trig;
+	uint8_t decim;			/* keep one record in decim */
+	uint8_t div;
+	uint16_t level;
+	uint16_t prev;			/* last compared value, for the edge */
+	uint16_t time;
+	uint16_t pre;			/* records kept from before the trigger, fewer if it came early */
+	uint16_t left;			/* records still to take after the trigger */
+	uint16_t head;
+	uint16_t count;
+	capture_rec_t rec[CAPTURE_SIZE];
+} capture_t;
+
+extern capture_t capture;
+
+uint8_t capture_arm(uint8_t trig, uint16_t level, uint8_t decim, uint16_t pre);	/* 0 or 1 on bad arguments */
+void capture_stop(void);
+uint8_t capture_dump(unsigned int ubrr_normal);	/* one step, ms until the next one, 0 when done */
+
+/** For ISR(ADC_vect) on the control channel, about 60 cycles when recording,
+* a few when idle*/
+static inline void capture_sample(uint16_t raw, uint16_t out)
+{
+	capture_t *c=&capture;
+	capture_rec_t *r;
+
+	if(c->state<CAP_ARMED) return;
+	c->time++;
+	if(++c->div<c->decim) return;
+	c->div=0;
+
+	if(c->state==CAP_ARMED){
+		uint16_t v=c->trig==CAP_TRIG_OUT?out:raw;
+		uint8_t hit;
+		if(c->trig==CAP_TRIG_NOW) hit=1;
+		else if(c->trig==CAP_TRIG_FALL) hit=v<c->level && c->prev>=c->level;
+		else hit=v>=c->level && c->prev<c->level;
+		c->prev=v;
+		if(hit){
+			c->state=CAP_TRIGGERED;
+			if(c->count<c->pre) c->pre=c->count;	/* what the dump really holds */
+		}
+	}
+
+	r=&c->rec[c->head];
+	r->raw=raw;
+	r->out=out;
+	r->time=c->time;
+	c->head=(c->head+1)&(CAPTURE_SIZE-1);
+	if(c->count<CAPTURE_SIZE) c->count++;
+
+	if(c->state==CAP_TRIGGERED && !--c->left) c->state=CAP_DONE;
+}
+
+#endif /* CAPTURE_H_ */
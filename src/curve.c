@@ -0,0 +1,124 @@
+/*
+ * curve.c
+ * transfer curves for curve.h, integer math only so the float library stays out
+ */
+#include "curve.h"
+
+uint16_t curve_lut[CURVE_SIZE];
+uint16_t curve_low[CURVE_LOW+1];
+uint16_t curve_points[CURVE_POINTS]={
+	0,64,128,192,256,320,384,448,512,576,640,704,768,832,896,960,1023
+};
+
+/* log2(1 + i/16) in Q12 */
+static const uint16_t log2_tab[17] PROGMEM={
+	0,358,696,1016,1319,1607,1882,2145,2396,2637,2869,3092,3307,3514,3715,3908,4096
+};
+
+/* 2^(-i/16) in Q15 */
+static const uint16_t exp2_tab[17] PROGMEM={
+	32768,31379,30048,28774,27554,26386,25268,24196,23170,22188,21247,20347,19484,18658,17867,17109,16384
+};
+
+//================================================================================================================================
+//	fixed point helpers
+//================================================================================================================================
+
+/** log2(x) in Q12 for x >= 1, about 0.001 error from the interpolation*/
+static uint16_t curve_log2(uint16_t x)
+{
+	uint8_t n=15;
+	uint16_t a,b;
+
+	while(!(x&0x8000)){		/* normalise, n = integer part */
+		x<<=1;
+		n--;
+	}
+	a=pgm_read_word(&log2_tab[(x>>11)&15]);
+	b=pgm_read_word(&log2_tab[((x>>11)&15)+1]);
+	return ((uint16_t)n<<12)+a+(uint16_t)(((uint32_t)(b-a)*(x&0x7FF))>>11);
+}
+
+/** 2^(-e/4096) in Q15*/
+static uint16_t curve_exp2neg(uint32_t e)
+{
+	uint8_t i=(e>>8)&15;
+	uint16_t a,b;
+
+	if(e>=(15UL<<12)) return 0;		/* below 1 LSB of Q15 */
+	a=pgm_read_word(&exp2_tab[i]);
+	b=pgm_read_word(&exp2_tab[i+1]);
+	return (a-(uint16_t)(((uint32_t)(a-b)*(e&255))>>8))>>(e>>12);
+}
+
+/** curve value for one input, 0..1023*/
+static uint16_t curve_eval(uint8_t type, uint16_t g8, uint16_t x)
+{
+	switch(type)
+	{
+		case CURVE_LOG:		/* 1023/40960 = 26188 / 2^20 */
+		return ((uint32_t)curve_log2(x+1)*26188+(1UL<<19))>>20;
+
+		case CURVE_GAMMA:
+		{
+			uint32_t e;
+			if(!x) return 0;
+			e=((uint32_t)(curve_log2(1023)-curve_log2(x))*g8)>>8;
+			return ((uint32_t)curve_exp2neg(e)*1023+16384)>>15;
+		}
+
+		case CURVE_CUSTOM:
+		{
+			uint8_t i=x>>6;
+			uint16_t a=curve_points[i];
+			int16_t d=curve_points[i+1]-a;
+			uint8_t span=i==CURVE_POINTS-2?63:64;	/* last segment ends at 1023 */
+			return a+(int16_t)((int32_t)d*(x&63)/span);
+		}
+
+		default:
+		return x;
+	}
+}
+
+//================================================================================================================================
+//	table
+//================================================================================================================================
+
+void curve_build(uint8_t type, uint8_t gamma10, uint8_t min_pwm, uint8_t max_pwm)
+{
+	/* 8-bit limits to 10-bit, as the ISR used to do per sample */
+	uint16_t lo=((uint32_t)min_pwm*1023+127)/255;
+	uint16_t hi=((uint32_t)max_pwm*1023+127)/255;
+	uint16_t g8=((uint16_t)gamma10*128+2)/5;	/* gamma in Q8 */
+	uint16_t i, y=0;
+
+	for(i=0;i<CURVE_SIZE;i++)
+	{
+		uint16_t a=y;
+		y=curve_eval(type,g8,i<CURVE_SIZE-1?i<<CURVE_SHIFT:1023);
+		if(y<lo) y=lo;
+		if(y>hi) y=hi;
+		if(i==CURVE_SIZE-1)
+		{
+			/* the last segment is one code short: stretch it so curve_map(4092) is y */
+			const int16_t m=(1<<CURVE_SHIFT)-1;
+			int16_t t=y-a;
+			y=a+(t>=0?(t*(m+1)+m-1)/m:-((-t*(m+1))/m));
+		}
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			curve_lut[i]=y;
+		}
+	}
+	for(i=0;i<=CURVE_LOW;i++)
+	{
+		y=curve_eval(type,g8,i);
+		if(y<lo) y=lo;
+		if(y>hi) y=hi;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			curve_low[i]=y;
+		}
+	}
+}
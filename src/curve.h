@@ -0,0 +1,71 @@
+/*
+ * curve.h
+ * lookup table from the ADC value to OCR1A, MIN/MAX clamp included. the table is
+ * built over 10-bit codes, curve_map() takes the 12-bit filter output so the extra
+ * bits of oversampling and the IIR fall between the entries
+ *
+ * built in the main loop when settings are applied, so ISR(ADC_vect) needs one lookup
+ * and a linear interpolation. parts with 4 KB SRAM or more get an entry every 8 codes
+ * (129 entries, 258 bytes), smaller ones every 16 codes (65 entries, 130 bytes). a full
+ * 1024 entry table would take 2 KB, a quarter of the ATmega2560's SRAM.
+ */
+
+
+#ifndef CURVE_H_
+#define CURVE_H_
+
+#include "hal.h"
+
+#define CURVE_LINEAR	0		/* output = input */
+#define CURVE_LOG		1		/* 1023 * log2(x + 1) / 10 */
+#define CURVE_GAMMA		2		/* 1023 * (x / 1023) ^ gamma */
+#define CURVE_CUSTOM	3		/* straight lines through curve_points[] */
+
+#define CURVE_GAMMA_MIN	10		/* gamma * 10, the range the commands accept */
+#define CURVE_GAMMA_MAX	50
+
+#define CURVE_POINTS	17		/* custom curve, one point every 64 codes, last one at 1023 */
+
+#if RAMEND >= 0x1000
+#define CURVE_SHIFT		3		/* codes per entry = 2^CURVE_SHIFT */
+#else
+#define CURVE_SHIFT		4
+#endif
+#define CURVE_SIZE		((1024>>CURVE_SHIFT)+1)	/* last entry at 1023 */
+
+#define CURVE_LOW		(1<<CURVE_SHIFT)	/* the first entry span again, one entry per code */
+
+extern uint16_t curve_lut[CURVE_SIZE];
+extern uint16_t curve_low[CURVE_LOW+1];	/* the log curve rises by 324 over codes 0..8 */
+
+/* against the exact curves, curve_map() is within 9 codes for CURVE_LOG (worst between
+ * codes 0 and 1) and within 2 codes for the others */
+extern uint16_t curve_points[CURVE_POINTS];	/* custom curve outputs 0..1023 */
+
+/** Rebuild the table. gamma10 is gamma * 10 (CURVE_GAMMA_MIN..MAX), only used by CURVE_GAMMA.
+* min_pwm/max_pwm (0..255) clamp the output like the original ISR did.
+* Every entry is written with interrupts off, the ADC ISR keeps running.*/
+void curve_build(uint8_t type, uint8_t gamma10, uint8_t min_pwm, uint8_t max_pwm);
+
+#define CURVE_XSHIFT	(CURVE_SHIFT+2)	/* 12-bit input codes per entry = 2^CURVE_XSHIFT */
+
+/** 12-bit ADC value (0..4092, the adc_filter output) to OCR1A, constant time, for ISR(ADC_vect)*/
+static inline uint16_t curve_map(uint16_t x)
+{
+	uint8_t k=x>>CURVE_XSHIFT;
+	uint16_t a;
+	int16_t d;
+
+	if(!k)
+	{
+		k=x>>2;
+		a=curve_low[k];
+		d=curve_low[k+1]-a;
+		return a+((d*(int8_t)(x&3))>>2);
+	}
+	a=curve_lut[k];
+	d=curve_lut[k+1]-a;
+	return a+(int16_t)(((int32_t)d*(x&((1<<CURVE_XSHIFT)-1)))>>CURVE_XSHIFT);
+}
+
+#endif /* CURVE_H_ */
@@ -0,0 +1,62 @@
+/*
+ * fmt.c
+ * decimal conversion by repeated subtraction, at most 9 per digit and no division
+ */
+#include "fmt.h"
+#include "hal.h"
+
+static const uint16_t fmt_decades[4] PROGMEM = { 10000, 1000, 100, 10 };
+static const uint32_t fmt_decades32[9] PROGMEM = {
+	1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10
+};
+
+/** v right aligned in width characters with blanks in front, no terminator.
+* A value with more digits than width comes out as width '*'. Returns dst+width*/
+char *fmt_u16(char *dst, uint16_t v, uint8_t width)
+{
+	char digits[5];
+	uint8_t i,lead;
+
+	for(i=0;i<4;i++)
+	{
+		uint16_t decade=pgm_read_word(&fmt_decades[i]);
+		char c='0';
+		while(v>=decade)
+		{
+			v-=decade;
+			c++;
+		}
+		digits[i]=c;
+	}
+	digits[4]='0'+v;
+	for(lead=0;lead<4 && digits[lead]=='0';lead++) digits[lead]=' ';
+
+	for(i=0;i<width;i++)
+	{
+		int8_t pos=5-width+i;	/* digit under this character, <0 is padding */
+		if(5-lead>width) dst[i]='*';
+		else dst[i]=pos<0?' ':digits[pos];
+	}
+	return dst+width;
+}
+
+/** v left aligned without leading zeros, for the UART reports. Returns the end, no terminator*/
+char *fmt_u32(char *dst, uint32_t v)
+{
+	uint8_t i,started=0;
+
+	for(i=0;i<9;i++)
+	{
+		uint32_t decade=pgm_read_dword(&fmt_decades32[i]);
+		char c='0';
+		while(v>=decade)
+		{
+			v-=decade;
+			c++;
+		}
+		if(c!='0') started=1;
+		if(started) *dst++=c;
+	}
+	*dst++='0'+v;
+	return dst;
+}
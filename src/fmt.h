@@ -0,0 +1,28 @@
+/*
+ * fmt.h
+ * number formatting for the display and the UART reports without printf: decimal digits by subtracting
+ * powers of ten, scaling (e.g. 10-bit PWM to percent) by a reciprocal multiply
+ * worked out by the compiler
+ */
+
+
+#ifndef FMT_H_
+#define FMT_H_
+
+#include <stdint.h>
+
+#define FMT_SHIFT		18
+
+/** round(v*scale/full) == fmt_scale(v, FMT_RECIP(scale, full)) for every 10-bit v with the
+* ranges used here. scale must stay below full/4 for the reciprocal to fit 16 bits*/
+#define FMT_RECIP(scale, full)	((uint16_t)((((uint32_t)(scale)<<FMT_SHIFT)+(full)/2)/(full)))
+
+static inline uint16_t fmt_scale(uint16_t v, uint16_t recip)
+{
+	return ((uint32_t)v*recip+(1UL<<(FMT_SHIFT-1)))>>FMT_SHIFT;
+}
+
+char *fmt_u16(char *dst, uint16_t v, uint8_t width);	/* right aligned, returns dst+width, no '\0' */
+char *fmt_u32(char *dst, uint32_t v);	/* as many digits as needed (1..10), returns the end, no '\0' */
+
+#endif /* FMT_H_ */
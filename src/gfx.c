@@ -0,0 +1,223 @@
+/*
+ * gfx.c
+ * page band renderer, 2 x 128 bytes of SRAM instead of a 1 KB framebuffer. the price is
+ * running the scene 8 times per frame, every primitive returns early outside the band.
+ */
+#include <string.h>
+#include "hal.h"
+#include "I2C.h"
+#include "ssd1306.h"
+#include "gfx.h"
+
+extern const char myFont[][8] PROGMEM;	/* data.h, ascii 0x20-0x7F */
+
+#define GFX_PAGES		(SSD1306_LCDHEIGHT/8)
+
+static uint8_t gfx_bands[GFX_BANDS][SSD1306_LCDWIDTH];
+static volatile uint8_t gfx_sent[GFX_BANDS]={[0 ... GFX_BANDS-1]=I2C_DONE};	/* band free again */
+static uint8_t *gfx_band;		/* band being drawn */
+static int16_t gfx_top;			/* its first pixel row */
+
+int16_t gfx_band_top(void)
+{
+	return gfx_top;
+}
+
+/** Run the scene once per page and send each band as one data transaction. The window
+* covers the whole screen so the column and page pointers wrap from band to band by
+* themselves. With SSD1306_FRAMEBUFFER the back frame no longer matches the display
+* afterwards, call ssd1306_invalidate() before the next flush.*/
+void gfx_render(gfx_scene_t scene)
+{
+	uint8_t page, k;
+
+	ssd1306_window(0,0,SSD1306_LCDWIDTH,GFX_PAGES);
+	for(page=0;page<GFX_PAGES;page++)
+	{
+		k=page%GFX_BANDS;
+		while(!(gfx_sent[k]&I2C_DONE))	//band still on the bus from page-GFX_BANDS
+		{
+			if(hal_irq_enabled()) hal_spin();
+			else I2C_Wait();			//nobody runs the TWI interrupt, drive it by hand
+		}
+		gfx_band=gfx_bands[k];
+		gfx_top=page*8;
+		memset(gfx_band,0,SSD1306_LCDWIDTH);
+		scene();
+		ssd1306_data_begin();
+		ssd1306_data_write_buf(gfx_band,SSD1306_LCDWIDTH);
+		ssd1306_data_end_done(&gfx_sent[k]);
+	}
+	gfx_band=0;
+}
+
+#ifndef SSD1306_FRAMEBUFFER
+/** without the framebuffer drawPixel() draws into the band of gfx_render(), call it from a scene*/
+void drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+	gfx_pixel(x,y,color);
+}
+#endif
+
+/** combine the bits of mask into band column x*/
+static inline void gfx_put(int16_t x, uint8_t mask, uint8_t color)
+{
+	switch(color)
+	{
+		case WHITE:   gfx_band[x]|=mask; break;
+		case BLACK:   gfx_band[x]&=~mask; break;
+		case INVERSE: gfx_band[x]^=mask; break;
+	}
+}
+
+/** bits of the band covered by rows y..y+h-1, 0 when they miss it*/
+static uint8_t gfx_rows(int16_t y, int16_t h)
+{
+	int16_t y0=y-gfx_top, y1=y0+h;
+
+	if(h<=0 || y1<=0 || y0>=8) return 0;
+	if(y0<0) y0=0;
+	if(y1>8) y1=8;
+	return (uint8_t)((0xFF<<y0)&(0xFF>>(8-y1)));
+}
+
+/** place an 8 row column byte with its bit 0 at pixel row y*/
+static void gfx_column(int16_t x, int16_t y, uint8_t bits, uint8_t color)
+{
+	int16_t shift=y-gfx_top;
+	uint8_t mask;
+
+	if(x<0 || x>=SSD1306_LCDWIDTH || shift<=-8 || shift>=8) return;
+	mask=shift>=0?bits<<shift:bits>>-shift;
+	if(color==BLACK) gfx_band[x]&=~mask;	//only the set bits of the glyph are drawn
+	else gfx_put(x,mask,color);
+}
+
+void gfx_pixel(int16_t x, int16_t y, uint8_t color)
+{
+	if(x<0 || x>=SSD1306_LCDWIDTH || y<gfx_top || y>=gfx_top+8) return;
+	gfx_put(x,1<<(y-gfx_top),color);
+}
+
+void gfx_hline(int16_t x, int16_t y, int16_t w, uint8_t color)
+{
+	gfx_fill_rect(x,y,w,1,color);
+}
+
+void gfx_vline(int16_t x, int16_t y, int16_t h, uint8_t color)
+{
+	gfx_fill_rect(x,y,1,h,color);
+}
+
+/** one byte operation per column of the band*/
+void gfx_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color)
+{
+	uint8_t mask=gfx_rows(y,h);
+	int16_t x1=x+w;
+
+	if(!mask) return;
+	if(x<0) x=0;
+	if(x1>SSD1306_LCDWIDTH) x1=SSD1306_LCDWIDTH;
+	for(;x<x1;x++) gfx_put(x,mask,color);
+}
+
+void gfx_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color)
+{
+	if(w<=0 || h<=0) return;
+	gfx_hline(x,y,w,color);
+	if(h>1) gfx_hline(x,y+h-1,w,color);
+	if(h>2)
+	{
+		gfx_vline(x,y+1,h-2,color);
+		if(w>1) gfx_vline(x+w-1,y+1,h-2,color);
+	}
+}
+
+/** Bresenham, lines that miss the band in y are skipped as a whole*/
+void gfx_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color)
+{
+	int16_t dx, dy, sx, sy, err, e2;
+
+	if((y0<gfx_top && y1<gfx_top) || (y0>=gfx_top+8 && y1>=gfx_top+8)) return;
+	if(x0==x1){
+		if(y1<y0){ e2=y0; y0=y1; y1=e2; }
+		gfx_vline(x0,y0,y1-y0+1,color);
+		return;
+	}
+	if(y0==y1){
+		if(x1<x0){ e2=x0; x0=x1; x1=e2; }
+		gfx_hline(x0,y0,x1-x0+1,color);
+		return;
+	}
+	dx=x1>x0?x1-x0:x0-x1;
+	dy=y1>y0?y0-y1:y1-y0;	//negative
+	sx=x0<x1?1:-1;
+	sy=y0<y1?1:-1;
+	err=dx+dy;
+	for(;;)
+	{
+		gfx_pixel(x0,y0,color);
+		if(x0==x1 && y0==y1) break;
+		e2=2*err;
+		if(e2>=dy){ err+=dy; x0+=sx; }
+		if(e2<=dx){ err+=dx; y0+=sy; }
+	}
+}
+
+/** midpoint circle, every outline point once so INVERSE works*/
+void gfx_circle(int16_t x0, int16_t y0, int16_t r, uint8_t color)
+{
+	int16_t x=r, y=0, err=1-r;
+
+	if(r<0 || y0+r<gfx_top || y0-r>=gfx_top+8) return;
+	if(r==0){
+		gfx_pixel(x0,y0,color);
+		return;
+	}
+	while(x>=y)
+	{
+		gfx_pixel(x0+x,y0+y,color);
+		gfx_pixel(x0-x,y0-y,color);
+		if(y){
+			gfx_pixel(x0-x,y0+y,color);
+			gfx_pixel(x0+x,y0-y,color);
+		}
+		if(x!=y){
+			gfx_pixel(x0+y,y0+x,color);
+			gfx_pixel(x0-y,y0-x,color);
+			if(y){
+				gfx_pixel(x0-y,y0+x,color);
+				gfx_pixel(x0+y,y0-x,color);
+			}
+		}
+		y++;
+		if(err<0) err+=2*y+1;
+		else { x--; err+=2*(y-x)+1; }
+	}
+}
+
+void gfx_text(int16_t x, int16_t y, const char *s, uint8_t color)
+{
+	uint8_t c, i;
+
+	if(y<=gfx_top-8 || y>=gfx_top+8) return;
+	for(;*s && x<SSD1306_LCDWIDTH;s++,x+=8)
+	{
+		c=*s;
+		if(c<0x20 || c>0x7F || x<=-8) continue;
+		for(i=0;i<8;i++)
+		gfx_column(x+i,y,pgm_read_byte(&myFont[c-0x20][i]),color);
+	}
+}
+
+void gfx_bitmap_P(int16_t x, int16_t y, uint8_t w, uint8_t pages, const uint8_t *bmp, uint8_t color)
+{
+	uint8_t p, i;
+
+	for(p=0;p<pages;p++,bmp+=w,y+=8)
+	{
+		if(y<=gfx_top-8 || y>=gfx_top+8) continue;
+		for(i=0;i<w;i++)
+		gfx_column(x+i,y,pgm_read_byte(&bmp[i]),color);
+	}
+}
@@ -0,0 +1,36 @@
+/*
+ * gfx.h
+ * drawing primitives without a framebuffer: gfx_render() builds the screen one page
+ * (8 pixel rows) at a time in a 128 byte band. the scene callback redraws everything
+ * for every band, the primitives clip themselves to it, each finished band goes to
+ * the display in one data burst while the next one is drawn.
+ */
+
+
+#ifndef GFX_H_
+#define GFX_H_
+
+#include <stdint.h>
+
+#define GFX_BANDS		2	/* one band on the bus, one being drawn, 1 to wait instead */
+
+/** draws the whole screen with the gfx_*() calls, once per band*/
+typedef void (*gfx_scene_t)(void);
+
+void gfx_render(gfx_scene_t scene);
+int16_t gfx_band_top(void);		/* first pixel row of the band, to skip what lies elsewhere */
+
+//color is WHITE, BLACK or INVERSE from ssd1306.h, coordinates are pixels and may lie off screen
+void gfx_pixel(int16_t x, int16_t y, uint8_t color);
+void gfx_hline(int16_t x, int16_t y, int16_t w, uint8_t color);
+void gfx_vline(int16_t x, int16_t y, int16_t h, uint8_t color);
+void gfx_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color);
+void gfx_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color);
+void gfx_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color);
+void gfx_circle(int16_t x0, int16_t y0, int16_t r, uint8_t color);
+//8x8 glyphs of myFont with the top left corner at x,y, y needs not be a multiple of 8
+void gfx_text(int16_t x, int16_t y, const char *s, uint8_t color);
+//page organised bitmap in flash (like data.h), w columns by pages*8 rows
+void gfx_bitmap_P(int16_t x, int16_t y, uint8_t w, uint8_t pages, const uint8_t *bmp, uint8_t color);
+
+#endif /* GFX_H_ */
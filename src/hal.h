@@ -0,0 +1,60 @@
+/*
+ * hal.h
+ * thin hardware layer under the drivers: TWI, USART0, ADC, Timer0 tick, Timer1 PWM, Timer5 and GPIO
+ *
+ * the firmware includes this instead of the avr-libc headers. building with
+ * -DHAL_HOST swaps the register accessors for a simulator (hal_host.c) so the
+ * drivers, command parser and display code also run on Linux, with time counted
+ * in simulated CPU cycles instead of wall clock.
+ *
+ *   hal_irq_enabled()        global interrupt flag
+ *   hal_spin()               call inside every busy wait, lets the simulator move on
+ *   hal_sleep_idle()         idle sleep until the next interrupt, called with interrupts off
+ *   hal_twi_*()              TWCR/TWDR/TWSR/TWBR
+ *   hal_uart_*()             USART0, double speed 8N1
+ *   hal_adc_*()              ADC, auto-triggered by the Timer1 overflow; hal_adc_read_nr() in noise reduction sleep
+ *   hal_pwm_*()              Timer1 phase correct PWM on OC1A (PB5)
+ *   hal_prof_*()             Timer5 free running time base for prof.h
+ *   hal_tick_init()          Timer0 1 ms system tick, TIMER0_COMPA_vect
+ *   hal_gpio_*()
+ */
+
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <stdint.h>
+
+#ifdef HAL_HOST
+#include "hal_host.h"
+#else
+#include "hal_avr.h"
+#endif
+
+/* GPIO is plain memory on both sides, ddr/port/pin are &DDRx, &PORTx, &PINx */
+static inline void hal_gpio_output(volatile uint8_t *ddr, uint8_t bit)
+{
+	*ddr|=(1<<bit);
+}
+
+static inline void hal_gpio_write(volatile uint8_t *port, uint8_t bit, uint8_t level)
+{
+	if(level) *port|=(1<<bit);
+	else *port&=~(1<<bit);
+}
+
+static inline void hal_gpio_pullup(volatile uint8_t *port, uint8_t bit)
+{
+	*port|=(1<<bit);
+}
+
+static inline uint8_t hal_gpio_read(volatile uint8_t *pin, uint8_t bit)
+{
+	return (*pin>>bit)&1;
+}
+
+#endif /* HAL_H_ */
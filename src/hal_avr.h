@@ -0,0 +1,245 @@
+/*
+ * hal_avr.h
+ * ATmega2560 side of hal.h, register accesses the compiler inlines to single instructions
+ */
+
+
+#ifndef HAL_AVR_H_
+#define HAL_AVR_H_
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include <util/delay.h>
+
+static inline uint8_t hal_irq_enabled(void)
+{
+	return (SREG&(1<<SREG_I))!=0;
+}
+
+static inline void hal_spin(void)
+{
+}
+
+/** idle sleep until the next interrupt. call with interrupts off: sei() takes effect
+* after the next instruction, so an interrupt already pending still ends the sleep*/
+static inline void hal_sleep_idle(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+}
+
+//================================================================================================================================
+//	TWI
+//================================================================================================================================
+
+static inline void hal_twi_bitrate(uint8_t twbr)
+{
+	TWSR&=0xFC;		/* prescaler 1 */
+	TWBR=twbr;
+}
+
+/** writing TWINT=1 clears the flag and starts the next bus action*/
+static inline void hal_twi_ctrl(uint8_t twcr)
+{
+	TWCR=twcr;
+}
+
+static inline uint8_t hal_twi_ctrl_get(void)
+{
+	return TWCR;
+}
+
+static inline uint8_t hal_twi_status(void)
+{
+	return TWSR&0xF8;
+}
+
+static inline void hal_twi_put(uint8_t data)
+{
+	TWDR=data;
+}
+
+static inline uint8_t hal_twi_get(void)
+{
+	return TWDR;
+}
+
+//================================================================================================================================
+//	USART0
+//================================================================================================================================
+
+static inline void hal_uart_baud(uint16_t ubrr)
+{
+	UBRR0H=(unsigned char)(ubrr>>8);
+	UBRR0L=(unsigned char)ubrr;
+}
+
+/** double speed, 8N1, RX, TX and the RX complete interrupt*/
+static inline void hal_uart_init(uint16_t ubrr)
+{
+	hal_uart_baud(ubrr);
+	UCSR0A=(1<<U2X0);
+	UCSR0B=(1<<RXEN0)|(1<<TXEN0)|(1<<RXCIE0);
+	UCSR0C=(1<<UCSZ01)|(1<<UCSZ00);
+}
+
+/** send a byte and clear TXC0, so TXC0 only comes back after the last one*/
+static inline void hal_uart_put(uint8_t data)
+{
+	UDR0=data;
+	UCSR0A=(1<<U2X0)|(1<<TXC0);
+}
+
+static inline uint8_t hal_uart_get(void)
+{
+	return UDR0;
+}
+
+static inline uint8_t hal_uart_tx_ready(void)
+{
+	return (UCSR0A&(1<<UDRE0))!=0;
+}
+
+static inline uint8_t hal_uart_tx_done(void)
+{
+	return (UCSR0A&(1<<TXC0))!=0;
+}
+
+static inline void hal_uart_tx_irq(uint8_t on)
+{
+	if(on) UCSR0B|=(1<<UDRIE0);
+	else UCSR0B&=~(1<<UDRIE0);
+}
+
+//================================================================================================================================
+//	ADC
+//================================================================================================================================
+
+/** input for the next conversion, AVcc reference, keeps the Timer1 overflow trigger*/
+static inline void hal_adc_select(uint8_t ch)
+{
+	ADMUX=(1<<REFS0)|(ch&7);
+#ifdef MUX5
+	ADCSRB=(1<<ADTS2)|(1<<ADTS1)|((ch&8)?(1<<MUX5):0);
+#else
+	ADCSRB=(1<<ADTS2)|(1<<ADTS1);
+#endif
+}
+
+/** auto trigger on the Timer1 overflow, interrupt on completion, prescaler 128 -> 125 kHz*/
+static inline void hal_adc_init(uint8_t ch)
+{
+	hal_adc_select(ch);
+	TIFR1=(1<<TOV1);	/* the first trigger needs a rising edge of TOV1 */
+	ADCSRA=(1<<ADEN)|(1<<ADATE)|(1<<ADIE)|
+	(1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0);
+}
+
+static inline uint16_t hal_adc_read(void)
+{
+	return ADC;
+}
+
+/** One conversion of ch in ADC noise reduction sleep, for a sample without the
+* digital noise of the running CPU. clk_IO stops with the CPU, so Timer0/1/5, the
+* USART and the TWI halt for the ~104 us of the conversion. The auto trigger is
+* switched off meanwhile (a result waiting for the ISR is dropped) and ADMUX/ADCSRB
+* are put back. Call with interrupts off, it returns with them off; the ADC
+* interrupt that ends the sleep must leave the result alone.*/
+static inline uint16_t hal_adc_read_nr(uint8_t ch)
+{
+	uint8_t admux=ADMUX, adcsrb=ADCSRB;
+	uint16_t v;
+
+	ADCSRA&=~(1<<ADATE);
+	while(ADCSRA&(1<<ADSC));
+	ADCSRA|=(1<<ADIF);			/* written as one: clears a result nobody collected */
+	hal_adc_select(ch);
+	set_sleep_mode(SLEEP_MODE_ADC);
+	sleep_enable();
+	sei();
+	do{
+		sleep_cpu();			/* entering the mode starts the conversion */
+	}while(ADCSRA&(1<<ADSC));	/* woken early by another interrupt */
+	sleep_disable();
+	cli();
+	v=ADC;
+	ADMUX=admux;
+	ADCSRB=adcsrb;
+	TIFR1=(1<<TOV1);			/* set during the read, the trigger needs a new rising edge */
+	ADCSRA|=(1<<ADATE);
+	return v;
+}
+
+//================================================================================================================================
+//	Timer1 PWM
+//================================================================================================================================
+
+/** phase correct PWM on OC1A (PB5), no prescaler, TOP = ICR1*/
+static inline void hal_pwm_init(uint16_t top)
+{
+	DDRB|=(1<<PB5);
+	TCCR1A=(1<<COM1A1)|(1<<WGM11);
+	TCCR1B=(1<<WGM13)|(1<<CS10);
+	ICR1=top;
+}
+
+static inline void hal_pwm_set(uint16_t duty)
+{
+	OCR1A=duty;
+}
+
+static inline uint16_t hal_pwm_get(void)
+{
+	return OCR1A;
+}
+
+/** TOV1 is the ADC trigger, clearing it arms the next rising edge*/
+static inline void hal_pwm_clear_ovf(void)
+{
+	TIFR1=(1<<TOV1);
+}
+
+//================================================================================================================================
+//	Timer0 system tick
+//================================================================================================================================
+
+/** CTC at clk/64, compare match A every 1 ms*/
+static inline void hal_tick_init(void)
+{
+	TCCR0A=(1<<WGM01);
+	OCR0A=F_CPU/64/1000-1;
+	TIMSK0=(1<<OCIE0A);
+	TCCR0B=(1<<CS01)|(1<<CS00);
+}
+
+//================================================================================================================================
+//	Timer5 time base for prof.h
+//================================================================================================================================
+
+/** normal mode, free running at clk/64 -> 4 us per tick*/
+static inline void hal_prof_init(void)
+{
+	TCCR5A=0;
+	TCCR5B=(1<<CS51)|(1<<CS50);
+}
+
+/** atomic, an ISR touching another 16-bit timer register would clobber the shared TEMP byte*/
+static inline uint16_t hal_prof_now(void)
+{
+	uint16_t t;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		t=TCNT5;
+	}
+	return t;
+}
+
+#endif /* HAL_AVR_H_ */
@@ -0,0 +1,527 @@
+/*
+ * hal_host.c
+ * peripheral simulator behind hal_host.h, only built with -DHAL_HOST
+ *
+ * TWI: one device at hal_host_twi_addr acks everything, bus timing from TWBR. it is powered
+ * from PA0 and only answers hal_host_twi_boot_ms after reset (SIM_OLED_BOOT_MS)
+ * USART0: TX goes to stdout at the programmed baud rate, stdin (when it is not a
+ * terminal) is read at start up and fed to RX at the same rate once interrupts are
+ * enabled, like a host that waits for the banner
+ * Timer1/ADC: overflow every 2*TOP cycles, conversion 13.5 ADC clocks later
+ * Timer0: compare match every 1 ms once hal_tick_init() ran
+ * Timer5: the cycle count / 64. code costs no cycles here, so prof.h only sees waits
+ * button: PE4 reads high (pull-up) until hal_host_button_hold() pulls it low, with a
+ * few bounces on each edge. the firmware samples it from the 1 ms tick
+ * SIM_MS in the environment sets the simulated run time (default 2000 ms)
+ * tests take stdout, stdin and the end of the run over through the hal_host_* hooks
+ */
+#ifdef HAL_HOST
+
+#include "hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NEVER			UINT64_MAX
+#define ADC_CONV		1728		/* 13.5 ADC clocks at prescaler 128 */
+
+uint64_t hal_host_cycles;
+uint16_t hal_host_adc[16]={ 512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512 };
+uint8_t hal_host_twi_addr=0x78;
+uint16_t hal_host_twi_boot_ms=20;
+void (*hal_host_twi_sink)(uint8_t event, uint8_t data);
+uint64_t hal_host_end=UINT64_MAX;
+uint8_t hal_host_stdin=1;
+void (*hal_host_uart_sink)(uint8_t data);
+void (*hal_host_idle_hook)(void);
+
+volatile uint8_t SREG;
+volatile uint8_t DDRA, PORTA, PINA;
+volatile uint8_t DDRB, PORTB, PINB;
+volatile uint8_t DDRE, PORTE, PINE;
+
+/* vectors the firmware does not define */
+__attribute__((weak)) void USART0_RX_vect(void) {}
+__attribute__((weak)) void USART0_UDRE_vect(void) {}
+__attribute__((weak)) void ADC_vect(void) {}
+__attribute__((weak)) void TWI_vect(void) {}
+__attribute__((weak)) void TIMER0_COMPA_vect(void) {}
+
+static uint8_t twcr, twdr, twsr=0xF8, twbr;
+static uint8_t twi_owner;			/* we sent a START and no STOP yet */
+static uint8_t twi_ack;				/* the device acked its address */
+static uint8_t twi_result;			/* TWSR when the running action completes, 0 = STOP only */
+static uint64_t twi_due=NEVER;
+
+static uint16_t ubrr;
+static uint8_t uart_on, uart_rxcie, uart_udrie, uart_txc;
+static uint8_t tx_shift, tx_reg, tx_full;
+static uint64_t tx_due=NEVER;
+static uint8_t rx_data, rx_full;
+static uint8_t *rx_input;
+static size_t rx_len, rx_pos;
+static uint8_t rx_wait;				/* input waiting for sei() */
+static uint64_t rx_due=NEVER;
+
+static uint16_t icr1, ocr1a;
+static uint8_t tov1;
+static uint64_t ovf_due=NEVER;
+static uint8_t adc_on, adc_mux, adc_ch, adc_flag;
+static uint16_t adc_data;
+static uint64_t adc_due=NEVER;
+static uint8_t tick_flag;
+static uint64_t tick_due=NEVER;
+#define BUTTON_EDGES	8
+static uint64_t button_due[BUTTON_EDGES];	/* pending PE4 changes, NEVER = free slot */
+static uint8_t button_level[BUTTON_EDGES];
+
+//================================================================================================================================
+//	event loop
+//================================================================================================================================
+
+static uint32_t twi_scl(void)
+{
+	return 16+2*(uint32_t)twbr;
+}
+
+static uint32_t uart_byte(void)
+{
+	return 10*8*((uint32_t)ubrr+1);	/* 10 bits, double speed */
+}
+
+static void twi_event(uint8_t event, uint8_t data)
+{
+	if(hal_host_twi_sink) hal_host_twi_sink(event,data);
+}
+
+static void finish(void)
+{
+	fflush(stdout);
+	exit(0);
+}
+
+/** run every event that is due at hal_host_cycles*/
+static void events(void)
+{
+	uint64_t now=hal_host_cycles;
+
+	if(now>=hal_host_end) finish();
+
+	if(now>=twi_due){
+		twi_due=NEVER;
+		if(twi_result){
+			twsr=twi_result;
+			twcr|=(1<<TWINT);
+		}
+		twcr&=~(1<<TWSTO);
+	}
+
+	if(now>=tx_due){
+		if(hal_host_uart_sink) hal_host_uart_sink(tx_shift);
+		else putchar(tx_shift);
+		if(tx_full){
+			tx_shift=tx_reg;
+			tx_full=0;
+			tx_due=now+uart_byte();
+		}else{
+			tx_due=NEVER;
+			uart_txc=1;
+		}
+	}
+
+	if(now>=rx_due){
+		if(!rx_full) rx_data=rx_input[rx_pos];	/* else data overrun, the byte is lost */
+		rx_full=1;
+		rx_pos++;
+		rx_due=rx_pos<rx_len?now+uart_byte():NEVER;
+	}
+
+	if(now>=ovf_due){
+		ovf_due=now+2*(uint64_t)icr1;
+		if(!tov1 && adc_on && adc_due==NEVER){	/* rising edge of TOV1 triggers the ADC */
+			adc_ch=adc_mux;
+			adc_due=now+ADC_CONV;
+		}
+		tov1=1;
+	}
+
+	if(now>=adc_due){
+		adc_due=NEVER;
+		adc_data=hal_host_adc[adc_ch]&1023;
+		adc_flag=1;
+	}
+
+	if(now>=tick_due){
+		tick_due=now+F_CPU/1000;
+		tick_flag=1;
+	}
+
+	for(uint8_t i=0;i<BUTTON_EDGES;i++)
+	{
+		if(now<button_due[i]) continue;
+		button_due[i]=NEVER;
+		if(button_level[i]) PINE|=(1<<PE4);
+		else PINE&=~(1<<PE4);
+	}
+}
+
+/** call one vector like the hardware does, with I cleared until it returns*/
+static void vector(void (*isr)(void))
+{
+	SREG&=~(1<<SREG_I);
+	isr();
+	SREG|=(1<<SREG_I);
+}
+
+/** deliver pending interrupts, highest priority (lowest vector number) first*/
+static void interrupts(void)
+{
+	if(rx_wait && (SREG&(1<<SREG_I))){
+		rx_wait=0;
+		rx_due=hal_host_cycles+uart_byte();
+	}
+	while(SREG&(1<<SREG_I))
+	{
+		if(tick_flag){
+			tick_flag=0;
+			vector(TIMER0_COMPA_vect);
+		}else if(rx_full && uart_rxcie){
+			vector(USART0_RX_vect);		/* reading UDR0 clears the flag */
+			rx_full=0;
+		}else if(uart_udrie && !tx_full){
+			vector(USART0_UDRE_vect);
+			if(uart_udrie && !tx_full) break;	/* ISR left it on without sending, avoid spinning */
+		}else if(adc_flag){
+			adc_flag=0;
+			vector(ADC_vect);
+		}else if((twcr&(1<<TWINT)) && (twcr&(1<<TWIE)) && (twcr&(1<<TWEN))){
+			uint8_t before=twcr;
+			vector(TWI_vect);
+			if(twcr==before) break;
+		}else{
+			break;
+		}
+	}
+}
+
+static uint64_t next_event(void)
+{
+	uint64_t t=hal_host_end;
+	if(twi_due<t) t=twi_due;
+	if(tx_due<t) t=tx_due;
+	if(rx_due<t) t=rx_due;
+	if(ovf_due<t) t=ovf_due;
+	if(adc_due<t) t=adc_due;
+	if(tick_due<t) t=tick_due;
+	for(uint8_t i=0;i<BUTTON_EDGES;i++)
+	if(button_due[i]<t) t=button_due[i];
+	return t;
+}
+
+void hal_host_delay(uint32_t cycles)
+{
+	uint64_t target=hal_host_cycles+cycles;
+	uint64_t t;
+
+	while((t=next_event())<=target)
+	{
+		hal_host_cycles=t;
+		events();
+		interrupts();
+	}
+	hal_host_cycles=target;
+	interrupts();
+}
+
+/** a busy wait can only end after the next event, jump there*/
+void hal_spin(void)
+{
+	hal_host_cycles=next_event();
+	events();
+	interrupts();
+}
+
+/** same as a busy wait, with interrupts enabled like the sei() in front of SLEEP*/
+void hal_sleep_idle(void)
+{
+	if(hal_host_idle_hook) hal_host_idle_hook();
+	sei();
+	hal_spin();
+}
+
+static void button_edge(uint64_t at, uint8_t level)
+{
+	for(uint8_t i=0;i<BUTTON_EDGES;i++)
+	{
+		if(button_due[i]!=NEVER) continue;
+		button_due[i]=at;
+		button_level[i]=level;
+		return;
+	}
+}
+
+/** low for ms from now, the contacts chatter for about 1 ms on press and release*/
+void hal_host_button_hold(uint16_t ms)
+{
+	uint64_t now=hal_host_cycles;
+	uint64_t up=now+(uint64_t)ms*(F_CPU/1000);
+
+	button_edge(now,0);
+	button_edge(now+F_CPU/5000,1);
+	button_edge(now+F_CPU/1250,0);
+	button_edge(up,1);
+	button_edge(up+F_CPU/4000,0);
+	button_edge(up+F_CPU/1000,1);
+}
+
+void hal_host_button(void)
+{
+	hal_host_button_hold(100);
+}
+
+/** read SIM_MS and SIM_OLED_BOOT_MS once, before the first peripheral is used*/
+__attribute__((constructor)) static void hal_host_start(void)
+{
+	const char *ms=getenv("SIM_MS");
+	const char *boot=getenv("SIM_OLED_BOOT_MS");
+	hal_host_end=(uint64_t)(ms?atol(ms):2000)*(F_CPU/1000);
+	PINE=(1<<PE4);		/* button released */
+	for(uint8_t i=0;i<BUTTON_EDGES;i++) button_due[i]=NEVER;
+	if(boot) hal_host_twi_boot_ms=atoi(boot);
+}
+
+//================================================================================================================================
+//	TWI
+//================================================================================================================================
+
+void hal_twi_bitrate(uint8_t value)
+{
+	twsr&=0xFC;
+	twbr=value;
+}
+
+/** TWINT is write-one-to-clear: writing it starts START, SLA/data or STOP, writing 0 leaves it*/
+void hal_twi_ctrl(uint8_t value)
+{
+	if(!(value&(1<<TWINT))){
+		twcr=(twcr&(1<<TWINT))|value;
+		return;
+	}
+	twcr=value&~(1<<TWINT);
+	if(!(value&(1<<TWEN))) return;
+
+	if(value&(1<<TWSTA)){
+		uint32_t t=twi_scl();
+		if(twi_owner && (value&(1<<TWSTO))){	/* STOP then START */
+			twi_event(HAL_TWI_STOP,0);
+			twi_owner=0;
+			t+=twi_scl();
+		}
+		twi_event(HAL_TWI_START,0);
+		twi_result=twi_owner?0x10:0x08;
+		twi_owner=1;
+		twi_due=hal_host_cycles+t;
+	}else if(value&(1<<TWSTO)){
+		twi_event(HAL_TWI_STOP,0);
+		twi_owner=0;
+		twi_result=0;
+		twi_due=hal_host_cycles+twi_scl();
+	}else{
+		uint8_t last=twsr&0xF8;
+		twi_event(HAL_TWI_BYTE,twdr);
+		if(last==0x08 || last==0x10){	/* address byte */
+			twi_ack=(twdr&0xFE)==hal_host_twi_addr && (PORTA&1) &&
+			hal_host_cycles>=(uint64_t)hal_host_twi_boot_ms*(F_CPU/1000);
+			if(twdr&1) twi_result=twi_ack?0x40:0x48;
+			else twi_result=twi_ack?0x18:0x20;
+		}else if(last==0x40 || last==0x50){	/* reading, the device sends 0xFF */
+			twdr=0xFF;
+			twi_result=(value&(1<<TWEA))?0x50:0x58;
+		}else{
+			twi_result=twi_ack?0x28:0x30;
+		}
+		twi_due=hal_host_cycles+9*twi_scl();
+	}
+}
+
+uint8_t hal_twi_ctrl_get(void)
+{
+	return twcr;
+}
+
+uint8_t hal_twi_status(void)
+{
+	return twsr&0xF8;
+}
+
+void hal_twi_put(uint8_t data)
+{
+	twdr=data;
+}
+
+uint8_t hal_twi_get(void)
+{
+	return twdr;
+}
+
+//================================================================================================================================
+//	USART0
+//================================================================================================================================
+
+void hal_uart_baud(uint16_t value)
+{
+	fflush(stdout);
+	ubrr=value;
+}
+
+/** stdin is taken in one go so the RX timing does not depend on the pipe*/
+void hal_uart_init(uint16_t value)
+{
+	hal_uart_baud(value);
+	uart_on=1;
+	uart_rxcie=1;
+	if(hal_host_stdin && !rx_input && !isatty(0)){
+		size_t size=256;
+		size_t n;
+		rx_input=malloc(size);
+		while(rx_input && (n=fread(rx_input+rx_len,1,size-rx_len,stdin))>0)
+		{
+			rx_len+=n;
+			if(rx_len==size) rx_input=realloc(rx_input,size*=2);
+		}
+		rx_wait=rx_len>0;
+	}
+}
+
+/** more RX input, sent once the bytes before it are in*/
+void hal_host_uart_input(const char *data, uint16_t len)
+{
+	uint8_t *p=realloc(rx_input,rx_len+len);
+
+	if(!p) return;
+	rx_input=p;
+	memcpy(rx_input+rx_len,data,len);
+	rx_len+=len;
+	if(rx_due==NEVER) rx_wait=1;	/* starts on the next interrupt check with I set */
+}
+
+void hal_uart_put(uint8_t data)
+{
+	if(!uart_on) return;
+	uart_txc=0;
+	if(tx_due==NEVER){
+		tx_shift=data;
+		tx_due=hal_host_cycles+uart_byte();
+	}else{
+		tx_reg=data;		/* writing while full overwrites, as on the chip */
+		tx_full=1;
+	}
+}
+
+uint8_t hal_uart_get(void)
+{
+	rx_full=0;
+	return rx_data;
+}
+
+uint8_t hal_uart_tx_ready(void)
+{
+	return !tx_full;
+}
+
+uint8_t hal_uart_tx_done(void)
+{
+	return uart_txc;
+}
+
+void hal_uart_tx_irq(uint8_t on)
+{
+	uart_udrie=on;
+}
+
+//================================================================================================================================
+//	ADC and Timer1
+//================================================================================================================================
+
+void hal_adc_select(uint8_t ch)
+{
+	adc_mux=ch&15;
+}
+
+void hal_adc_init(uint8_t ch)
+{
+	hal_adc_select(ch);
+	tov1=0;
+	adc_on=1;
+}
+
+uint16_t hal_adc_read(void)
+{
+	return adc_data;
+}
+
+/** as on the chip: the auto trigger is off, a conversion still running completes
+* and its result is dropped, the quiet conversion wakes ISR(ADC_vect) on the way out.
+* Timer1 keeps running here, so TOV1 is normally set when the trigger comes back*/
+uint16_t hal_adc_read_nr(uint8_t ch)
+{
+	adc_on=0;
+	if(adc_due!=NEVER) hal_host_delay(adc_due-hal_host_cycles);
+	adc_flag=0;
+	sei();
+	hal_host_delay(ADC_CONV);
+	adc_data=hal_host_adc[ch&15]&1023;
+	adc_flag=1;
+	hal_host_delay(0);			/* delivers the ADC interrupt */
+	cli();
+	tov1=0;
+	adc_on=1;
+	return adc_data;
+}
+
+void hal_pwm_init(uint16_t top)
+{
+	DDRB|=(1<<PB5);
+	icr1=top;
+	ovf_due=hal_host_cycles+2*(uint64_t)top;
+}
+
+void hal_pwm_set(uint16_t duty)
+{
+	ocr1a=duty;
+}
+
+uint16_t hal_pwm_get(void)
+{
+	return ocr1a;
+}
+
+void hal_pwm_clear_ovf(void)
+{
+	tov1=0;
+}
+
+//================================================================================================================================
+//	Timer0
+//================================================================================================================================
+
+void hal_tick_init(void)
+{
+	tick_due=hal_host_cycles+F_CPU/1000;
+}
+
+//================================================================================================================================
+//	Timer5, clk/64 straight from the cycle count
+//================================================================================================================================
+
+void hal_prof_init(void)
+{
+}
+
+uint16_t hal_prof_now(void)
+{
+	return hal_host_cycles>>6;
+}
+
+#endif /* HAL_HOST */
@@ -0,0 +1,155 @@
+/*
+ * hal_host.h
+ * Linux side of hal.h (-DHAL_HOST): stand-ins for the avr-libc headers and the
+ * register accessors, implemented by the simulator in hal_host.c
+ *
+ * simulated time only moves in _delay_ms/_delay_us and in hal_spin(), which jumps to
+ * the next peripheral event. interrupts are delivered there when the I flag is set,
+ * in AVR vector priority order, so a run with the same input is the same every time.
+ */
+
+
+#ifndef HAL_HOST_H_
+#define HAL_HOST_H_
+
+#include <stdint.h>
+#include <string.h>
+
+//================================================================================================================================
+//	avr-libc stand-ins
+//================================================================================================================================
+
+#define ISR(vector)		void vector(void)
+void USART0_RX_vect(void);
+void USART0_UDRE_vect(void);
+void ADC_vect(void);
+void TWI_vect(void);
+void TIMER0_COMPA_vect(void);
+
+extern volatile uint8_t SREG;
+#define SREG_I			7
+#define cli()			(SREG&=~(1<<SREG_I))
+#define sei()			(SREG|=(1<<SREG_I))
+
+static inline uint8_t hal_host_cli_ret(void)
+{
+	cli();
+	return 1;
+}
+
+static inline void hal_host_restore(const uint8_t *sreg)
+{
+	SREG=*sreg;
+}
+
+#define ATOMIC_RESTORESTATE	uint8_t hal_sreg_save __attribute__((__cleanup__(hal_host_restore)))=SREG
+#define ATOMIC_BLOCK(type)	for(type,hal_todo=hal_host_cli_ret();hal_todo;hal_todo=0)
+
+#define PROGMEM
+#define PSTR(s)				(s)
+#define pgm_read_byte(p)	(*(const uint8_t *)(p))
+#define pgm_read_word(p)	(*(const uint16_t *)(p))
+#define pgm_read_dword(p)	(*(const uint32_t *)(p))
+#define memcpy_P			memcpy
+#define PGM_P				const char *
+#define strcmp_P			strcmp
+#define strncmp_P			strncmp
+#define strncpy_P			strncpy
+#define snprintf_P			snprintf
+
+void hal_host_delay(uint32_t cycles);
+#define _delay_us(us)		hal_host_delay((uint32_t)((us)*(F_CPU/1000000.0)))
+#define _delay_ms(ms)		hal_host_delay((uint32_t)((ms)*(F_CPU/1000.0)))
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+	uint8_t i;
+	crc^=data;
+	for(i=0;i<8;i++) crc=crc&0x80?(uint8_t)(crc<<1)^0x07:(uint8_t)(crc<<1);
+	return crc;
+}
+
+/* ATmega2560 memory size and the bit numbers the drivers use */
+#define RAMEND			0x21FF
+#define MUX5			3
+#define TWINT			7
+#define TWEA			6
+#define TWSTA			5
+#define TWSTO			4
+#define TWEN			2
+#define TWIE			0
+
+/* GPIO registers, plain memory */
+extern volatile uint8_t DDRA, PORTA, PINA;
+extern volatile uint8_t DDRB, PORTB, PINB;
+extern volatile uint8_t DDRE, PORTE, PINE;
+#define PA0				0
+#define DDA0			0
+#define PB5				5
+#define PE4				4
+
+//================================================================================================================================
+//	hal.h accessors, see hal_avr.h for what each one does on the chip
+//================================================================================================================================
+
+static inline uint8_t hal_irq_enabled(void)
+{
+	return (SREG&(1<<SREG_I))!=0;
+}
+void hal_spin(void);
+void hal_sleep_idle(void);
+
+void hal_twi_bitrate(uint8_t twbr);
+void hal_twi_ctrl(uint8_t twcr);
+uint8_t hal_twi_ctrl_get(void);
+uint8_t hal_twi_status(void);
+void hal_twi_put(uint8_t data);
+uint8_t hal_twi_get(void);
+
+void hal_uart_baud(uint16_t ubrr);
+void hal_uart_init(uint16_t ubrr);
+void hal_uart_put(uint8_t data);
+uint8_t hal_uart_get(void);
+uint8_t hal_uart_tx_ready(void);
+uint8_t hal_uart_tx_done(void);
+void hal_uart_tx_irq(uint8_t on);
+
+void hal_adc_select(uint8_t ch);
+void hal_adc_init(uint8_t ch);
+uint16_t hal_adc_read(void);
+uint16_t hal_adc_read_nr(uint8_t ch);
+
+void hal_pwm_init(uint16_t top);
+void hal_pwm_set(uint16_t duty);
+uint16_t hal_pwm_get(void);
+void hal_pwm_clear_ovf(void);
+
+void hal_prof_init(void);
+uint16_t hal_prof_now(void);
+
+void hal_tick_init(void);
+
+//================================================================================================================================
+//	simulator controls
+//================================================================================================================================
+
+/* TWI bus events for hal_host_twi_sink */
+#define HAL_TWI_START	0		/* data = 0 */
+#define HAL_TWI_BYTE	1		/* address or data byte on the bus */
+#define HAL_TWI_STOP	2
+
+extern uint64_t hal_host_cycles;			/* simulated CPU cycles since reset */
+extern uint16_t hal_host_adc[16];			/* input of each ADC channel, 0..1023 */
+extern uint8_t hal_host_twi_addr;			/* SLA+W the simulated device acks (0x78) */
+extern uint16_t hal_host_twi_boot_ms;		/* the device nacks until then (20) */
+extern void (*hal_host_twi_sink)(uint8_t event, uint8_t data);	/* sees every bus event */
+extern uint64_t hal_host_end;				/* the run exits at this cycle (SIM_MS) */
+extern uint8_t hal_host_stdin;				/* 1: hal_uart_init() feeds stdin to RX */
+extern void (*hal_host_uart_sink)(uint8_t data);	/* gets TX bytes instead of stdout */
+extern void (*hal_host_idle_hook)(void);	/* called in hal_sleep_idle(), interrupts off */
+
+void hal_host_button(void);				/* short press on PE4, 100 ms */
+void hal_host_button_hold(uint16_t ms);	/* press on PE4 for ms, both edges bounce */
+void hal_host_uart_input(const char *data, uint16_t len);	/* queued behind the input still due */
+
+#endif /* HAL_HOST_H_ */
@@ -1,269 +1,918 @@
 // === Included Libraries ===
-#include <avr/io.h>         // Core I/O register definitions
-#include <util/delay.h>     // Delay functions
-#include <stdio.h>          // sprintf & friends
 #include <stdlib.h>         // atoi, etc.
 #include <string.h>         // String functions
-#include <avr/interrupt.h>  // Interrupt macros
+#include "hal.h"            // Registers, delays, ISR and ATOMIC_BLOCK (AVR or host simulator)
 #include "I2C.h"            // I2C driver
 #include "ssd1306.h"        // OLED display driver
+#include "uart.h"           // UART driver with TX/RX ring buffers
+#include "proto.h"          // Binary command frames
+#include "adc.h"            // Auto-triggered ADC scan sequencer
+#include "adc_filter.h"     // Oversampling / IIR / median stage for the ADC
+#include "curve.h"          // ADC to PWM lookup table
+#include "capture.h"        // Sample capture ring with trigger
+#include "prof.h"           // Timer5 probes, STATS command
+#include "fmt.h"            // printf-free number formatting
+#include "widget.h"         // Display fields that only send changes
+#include "button.h"         // Debounced button events from the 1 ms tick
+#include "sched.h"          // Cooperative tasks on the 1 ms tick
+#include "power.h"          // Display dim/off on idle, current estimate
+#include "pid.h"            // Closed loop mode
 
 // === UART Setup ===
 #define BAUD 19200
 #define MYUBRR ((F_CPU/8/BAUD)-1)  // UART baud rate formula with double speed
 
 // UART Buffers & Flags
-volatile char uart_buffer[32];   // Buffer for incoming UART text
-volatile uint8_t uart_index = 0; // Index in the buffer
-volatile uint8_t uart_rx_flag = 0; // Set when full line is received
-volatile int button_flag = 0;    // Set on button press (INT4)
+char uart_line[32];              // Command line taken out of the RX ring
+uint8_t binary_mode = 0;         // 1 after "BIN": commands arrive as proto.h frames
+proto_frame_t rx_frame;          // Frame being received in binary mode
+
+// === Tasks ===
+// Table order is the order within a scheduler pass, see task_table below
+enum {
+    TASK_BUTTON,
+    TASK_UART,
+    TASK_CAPTURE,
+    TASK_DISPLAY,
+    TASK_BLINK,
+    TASK_REPORT,
+    TASK_POWER,
+    TASK_COUNT
+};
+#define DISPLAY_HZ 50      // Default refresh rate, FPS:<1-100> changes it
+#define BLINK_MS   250     // Bar blink half period at MAX
+
+// === Display Power Up ===
+// I2C_Init() switches the display supply on, it answers once its reset is over
+#define OLED_BOOT_TIMEOUT_MS 1000
 
-// === UART Initialization ===
-void uart_init(unsigned int ubrr) {
-    // Set baud rate
-    UBRR0H = (unsigned char)(ubrr >> 8);
-    UBRR0L = (unsigned char)ubrr;
+// === PWM Using Timer1 ===
+void timer1_pwm_init() {
+    // Phase-correct PWM on PB5 (OC1A), no prescaler
+    hal_pwm_init(1023); // TOP = 1023 (matches 10-bit ADC)
+    // The overflow starts the ADC by hardware (adc.h), no interrupt needed
+}
+
+// === ADC Result ===
+volatile uint16_t pwm_value = 0; // For display use
+
+// === PWM Clamp Range ===
+uint8_t min_pwm = 0;
+uint8_t max_pwm = 255;
 
-    UCSR0A = (1 << U2X0); // Enable double speed mode
-    UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0); // Enable RX, TX, and RX complete interrupt
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00); // 8-bit data
-    
-    // Setup button interrupt
-    PORTE |= (1<<PE4);  // Enable pull-up resistor on PE4 (button)
-    EIMSK |= (1<<INT4); // Enable external interrupt INT4
-    EICRB |= (1<<ISC41); // Trigger INT4 on rising edge
+// Temporary variables for new settings (to be confirmed with button)
+uint8_t temp_min_pwm = 0;
+uint8_t temp_max_pwm = 255;
+uint8_t new_pwm_values_received = 0;
+
+// Transfer curve, staged and applied with the button like MIN/MAX
+uint8_t curve_type = CURVE_LINEAR;
+uint8_t curve_gamma = 22;          // Gamma * 10
+uint8_t temp_curve_type = CURVE_LINEAR;
+uint8_t temp_curve_gamma = 22;
+
+// === ADC Conversion Complete ISR ===
+ISR(ADC_vect) {
+    PROF_SCOPE(PROF_ISR_ADC);
+    uint8_t ch = adc_scan_step(); // Channel of this result, next one is set up
+    uint16_t adc_value = hal_adc_read();
+
+    if (ch == ADC_SKIP) return;
+    adc_result[ch] = adc_value;
+    if (ch != adc_scan.list[0]) return; // Only the first channel drives the PWM
+
+    uint16_t out;
+    if (filter_run(adc_value, &out)) {      // 0 while an oversampling block is still filling
+        if (!pid.on) {                      // Both take the 12-bit output, no bits thrown away
+            out = curve_map(out);           // Curve and MIN/MAX clamp, built on apply
+        } else if (pid_due()) {
+            out = pid_step(out);            // Closed loop on this channel, within MIN/MAX
+        } else {
+            out = pid.out;                  // Held between loop steps
+        }
+
+        hal_pwm_set(out);  // Update PWM duty
+        pwm_value = out;   // Store for OLED
+    }
+    capture_sample(adc_value, hal_pwm_get());
 }
 
-// Send a single character over UART
-void uart_send(char data) {
-    while (!(UCSR0A & (1 << UDRE0))); // Wait until ready
-    UDR0 = data; // Send char
+// === Shared Command Logic ===
+// Result codes match the binary NACK reasons
+uint8_t stage_min(int value) {
+    if (value < 0 || value > 255) return PROTO_ERR_RANGE;
+    if (value >= temp_max_pwm) return PROTO_ERR_CONFLICT;
+    temp_min_pwm = value;
+    new_pwm_values_received = 1;
+    return 0;
 }
 
-void uart_send_string(const char* str) {
-    while (*str) uart_send(*str++); // Send string
+uint8_t stage_max(int value) {
+    if (value < 0 || value > 255) return PROTO_ERR_RANGE;
+    if (value <= temp_min_pwm) return PROTO_ERR_CONFLICT;
+    temp_max_pwm = value;
+    new_pwm_values_received = 1;
+    return 0;
 }
 
-//interrupt service routine for UART RX
-// === UART RX Interrupt ===
-ISR(USART0_RX_vect) {
-    char received = UDR0;
-    if (received == '\r' || received == '\n') {
-        uart_buffer[uart_index] = '\0'; // End string
-        uart_index = 0;
-        uart_rx_flag = 1;
-    } else if (uart_index < sizeof(uart_buffer) - 1) {
-        uart_buffer[uart_index++] = received;
+// === Filter Commands ===
+// FILT:OFF, FILT:OS<1-3> or FILT:IIR<1-6>, optionally followed by ,MED
+uint8_t parse_filter(const char *arg) {
+    uint8_t mode, k = 0;
+    if (strncmp_P(arg, PSTR("OFF"), 3) == 0) {
+        mode = FILTER_OFF;
+        arg += 3;
+    } else if (strncmp_P(arg, PSTR("OS"), 2) == 0) {
+        mode = FILTER_OVERSAMPLE;
+        arg += 2;
+    } else if (strncmp_P(arg, PSTR("IIR"), 3) == 0) {
+        mode = FILTER_IIR;
+        arg += 3;
+    } else {
+        return PROTO_ERR_RANGE;
     }
+    if (mode != FILTER_OFF) {
+        if (*arg < '0' || *arg > '9') return PROTO_ERR_RANGE;
+        k = *arg++ - '0'; // Single digit, filter_set checks the range
+    }
+    if (*arg && strcmp_P(arg, PSTR(",MED")) != 0) return PROTO_ERR_RANGE;
+    return filter_set(mode, k, *arg != 0) ? PROTO_ERR_RANGE : 0;
 }
 
-// === PWM Using Timer1 ===
-void timer1_pwm_init() {
-    DDRB |= (1 << PB5); // Set PB5 (OC1A) as output
+void report_filter(void) {
+    static const char *const names[] = { "OFF", "OS", "IIR" };
+    uart_puts_P(PSTR("Filter: "));
+    uart_send_string(names[adc_filter.mode]);
+    uart_puts_P(PSTR(" k="));
+    uart_put_u32(adc_filter.k);
+    uart_puts_P(adc_filter.median ? PSTR(" median on\r\n") : PSTR(" median off\r\n"));
+}
 
-    // Phase-correct PWM, no prescaler
-    TCCR1A = (1 << COM1A1) | (1 << WGM11);
-    TCCR1B = (1 << WGM13) | (1 << CS10);
-    ICR1 = 1023; // TOP = 1023 (matches 10-bit ADC)
-    TIMSK1 |= (1 << TOIE1); // Enable Timer1 overflow interrupt
+// === Scan Commands ===
+// A PID setpoint channel that leaves the list turns into a fixed setpoint at its last value
+uint8_t set_scan(const uint8_t *list, uint8_t n) {
+    if (adc_set_scan(list, n)) return PROTO_ERR_RANGE;
+    pid_scan_changed();
+    return 0;
 }
 
-// === Timer Overflow Interrupt Starts ADC ===
-ISR(TIMER1_OVF_vect) {
-    ADCSRA |= (1 << ADSC); // Start ADC conversion
+// SCAN:<ch>,<ch>,... with up to ADC_SCAN_MAX channels, the first drives the PWM
+uint8_t parse_scan(const char *arg) {
+    uint8_t list[ADC_SCAN_MAX];
+    uint8_t n = 0;
+    while (*arg) {
+        if (n == ADC_SCAN_MAX || *arg < '0' || *arg > '9') return PROTO_ERR_RANGE;
+        unsigned long ch = strtoul(arg, (char **)&arg, 10);
+        if (ch >= ADC_CHANNELS) return PROTO_ERR_RANGE; // Before it is cut to 8 bits
+        list[n++] = ch;
+        if (*arg == ',') arg++;
+    }
+    return set_scan(list, n);
 }
 
-// === ADC Init & ISR ===
-volatile uint16_t pwm_value = 0; // For display use
+// One "ch=value" per scan entry
+void report_adc(void) {
+    for (uint8_t i = 0; i < adc_scan.n; i++) {
+        uint8_t ch = adc_scan.list[i];
+        uint16_t value;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            value = adc_result[ch];
+        }
+        uart_puts_P(i ? PSTR(" ADC") : PSTR("ADC"));
+        uart_put_u32(ch);
+        uart_send('=');
+        uart_put_u32(value);
+    }
+    uart_puts_P(PSTR("\r\n"));
+}
 
-void adc_init(void) {
-    ADMUX = (1 << REFS0); // AVcc as reference voltage, ADC0 as input
-    ADCSRA = (1 << ADEN)  | // Enable ADC
-             (1 << ADIE)  | // Enable ADC interrupt
-             (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0); // Prescaler 128 → 125kHz
+uint8_t stage_curve(uint8_t type, uint8_t gamma10) {
+    if (type > CURVE_CUSTOM) return PROTO_ERR_RANGE;
+    if (type == CURVE_GAMMA && (gamma10 < CURVE_GAMMA_MIN || gamma10 > CURVE_GAMMA_MAX)) return PROTO_ERR_RANGE;
+    temp_curve_type = type;
+    if (type == CURVE_GAMMA) temp_curve_gamma = gamma10;
+    new_pwm_values_received = 1;
+    return 0;
 }
 
-// === PWM Clamp Range ===
-uint8_t min_pwm = 0;
-uint8_t max_pwm = 255;
+// Custom curve points only reach the table when the button rebuilds it
+uint8_t stage_point(uint8_t index, uint16_t value) {
+    if (index >= CURVE_POINTS || value > 1023) return PROTO_ERR_RANGE;
+    curve_points[index] = value;
+    new_pwm_values_received = 1;
+    return 0;
+}
 
-// Temporary variables for new settings (to be confirmed with button)
-uint8_t temp_min_pwm = 0;
-uint8_t temp_max_pwm = 255;
-uint8_t new_pwm_values_received = 0;
+// CURVE:LIN, CURVE:LOG, CURVE:GAM<gamma*10>, CURVE:CUST or CURVE:P<point>=<0-1023>
+uint8_t parse_curve(const char *arg) {
+    if (strcmp_P(arg, PSTR("LIN")) == 0) return stage_curve(CURVE_LINEAR, 0);
+    if (strcmp_P(arg, PSTR("LOG")) == 0) return stage_curve(CURVE_LOG, 0);
+    if (strcmp_P(arg, PSTR("CUST")) == 0) return stage_curve(CURVE_CUSTOM, 0);
+    if (strncmp_P(arg, PSTR("GAM"), 3) == 0) {
+        int gamma10 = atoi(arg + 3); // Checked here, before it is narrowed to uint8_t
+        if (gamma10 < CURVE_GAMMA_MIN || gamma10 > CURVE_GAMMA_MAX) return PROTO_ERR_RANGE;
+        return stage_curve(CURVE_GAMMA, gamma10);
+    }
+    if (arg[0] == 'P') {
+        const char *eq = strchr(arg, '=');
+        if (!eq) return PROTO_ERR_RANGE;
+        int index = atoi(arg + 1);
+        int value = atoi(eq + 1);
+        if (index < 0 || index >= CURVE_POINTS || value < 0) return PROTO_ERR_RANGE;
+        return stage_point(index, value);
+    }
+    return PROTO_ERR_RANGE;
+}
 
-// === ADC Conversion Complete ISR ===
-ISR(ADC_vect) {
-    uint16_t adc_value = ADC; // Read ADC (0–1023)
+// === PID Commands ===
+// Gain as <int>[.<digits>] (0-127.99) to Q8.8, -1 if malformed
+int32_t parse_gain(const char *s) {
+    int32_t milli = 0, scale = 1000;
+    if (*s < '0' || *s > '9') return -1;
+    while (*s >= '0' && *s <= '9') {
+        milli = milli * 10 + (*s++ - '0');
+        if (milli > 127) return -1;
+    }
+    milli *= 1000;
+    if (*s == '.') {
+        s++;
+        while (*s >= '0' && *s <= '9') {
+            scale /= 10; // Digits after the third add nothing
+            milli += (*s++ - '0') * scale;
+        }
+    }
+    if (*s) return -1;
+    milli = (milli * 256 + 500) / 1000;
+    return milli > 32767 ? -1 : milli;
+}
+
+// PID:ON, PID:OFF, PID:KP=<g>, PID:KI=<g>, PID:KD=<g>, PID:SP=<0-1023>, PID:SP=A<ch>, PID:DIV=<1-255>
+uint8_t parse_pid(const char *arg) {
+    if (strcmp_P(arg, PSTR("ON")) == 0) {
+        pid_enable(1);
+        return 0;
+    }
+    if (strcmp_P(arg, PSTR("OFF")) == 0) {
+        pid_enable(0);
+        return 0;
+    }
+    if (arg[0] == 'K' && arg[1] && arg[2] == '=') { // arg[2] only exists past a non-NUL arg[1]
+        int32_t g = parse_gain(arg + 3);
+        if (g < 0) return PROTO_ERR_RANGE;
+        if (arg[1] == 'P') return pid_set_gains(g, pid.ki, pid.kd) ? PROTO_ERR_RANGE : 0;
+        if (arg[1] == 'I') return pid_set_gains(pid.kp, g, pid.kd) ? PROTO_ERR_RANGE : 0;
+        if (arg[1] == 'D') return pid_set_gains(pid.kp, pid.ki, g) ? PROTO_ERR_RANGE : 0;
+        return PROTO_ERR_RANGE;
+    }
+    if (strncmp_P(arg, PSTR("SP="), 3) == 0) {
+        if (arg[3] == 'A') {
+            int ch = atoi(arg + 4);
+            if (ch < 0 || ch >= ADC_CHANNELS) return PROTO_ERR_RANGE;
+            return pid_set_setpoint(ch, 0) ? PROTO_ERR_RANGE : 0;
+        }
+        int sp = atoi(arg + 3);
+        if (sp < 0) return PROTO_ERR_RANGE;
+        return pid_set_setpoint(PID_SP_FIXED, sp) ? PROTO_ERR_RANGE : 0;
+    }
+    if (strncmp_P(arg, PSTR("DIV="), 4) == 0) {
+        int div = atoi(arg + 4);
+        if (div < 1 || div > 255) return PROTO_ERR_RANGE;
+        return pid_set_div(div) ? PROTO_ERR_RANGE : 0;
+    }
+    return PROTO_ERR_RANGE;
+}
 
-    // Scale min/max from 8-bit to 10-bit
-    uint16_t scaled_min = ((uint32_t)min_pwm * 1023 + 127) / 255;
-    uint16_t scaled_max = ((uint32_t)max_pwm * 1023 + 127) / 255;
+// " <name>=<gain>", Q8.8 with three decimals
+void report_gain(const char *name, int16_t g) {
+    char milli[3];
+    fmt_u16(milli, ((g & 255) * 1000UL + 128) >> 8, 3);
+    for (uint8_t i = 0; i < 3 && milli[i] == ' '; i++) milli[i] = '0';
+    uart_puts_P(name);
+    uart_put_u32(g >> 8);
+    uart_send('.');
+    uart_write(milli, 3);
+}
 
-    // Clamp ADC value
-    if (adc_value < scaled_min) adc_value = scaled_min; //Set to min if below
-    if (adc_value > scaled_max) adc_value = scaled_max; //Set to max if above
+// Loop rate in 0.1 Hz: Timer1 period, scan length, oversampling block and divider
+uint32_t pid_rate_dhz(void) {
+    uint32_t den = (uint32_t)adc_scan.n * pid.div;
+    if (adc_filter.mode == FILTER_OVERSAMPLE) den <<= 2 * adc_filter.k;
+    return (F_CPU * 10 / 2046 + den / 2) / den;
+}
 
-    OCR1A = adc_value;       // Update PWM duty
-    pwm_value = adc_value;   // Store for OLED
+void report_pid(void) {
+    uint32_t dhz = pid_rate_dhz();
+    uart_puts_P(pid.on ? PSTR("PID on FB=ADC") : PSTR("PID off FB=ADC"));
+    uart_put_u32(adc_scan.list[0]);
+    if (pid.sp_ch == PID_SP_FIXED) {
+        uart_puts_P(PSTR(" SP="));
+        uart_put_u32(pid.sp);
+    } else {
+        uart_puts_P(PSTR(" SP=ADC"));
+        uart_put_u32(pid.sp_ch);
+    }
+    report_gain(PSTR(" KP="), pid.kp);
+    report_gain(PSTR(" KI="), pid.ki);
+    report_gain(PSTR(" KD="), pid.kd);
+    uart_puts_P(PSTR(" DIV="));
+    uart_put_u32(pid.div);
+    uart_puts_P(PSTR(" loop="));
+    uart_put_u32(dhz / 10);
+    uart_send('.');
+    uart_put_u32(dhz % 10);
+    uart_puts_P(PSTR("Hz\r\n"));
+}
+
+// === Capture Commands ===
+// CAP:NOW, CAP:RISE=<adc>, CAP:FALL=<adc> or CAP:MAX, then optional ,D<decimation> ,P<pre-trigger>
+uint8_t parse_capture(const char *arg) {
+    uint8_t trig;
+    uint16_t level = 0;
+    int decim = 1, pre = CAPTURE_SIZE / 4;
+
+    if (strncmp_P(arg, PSTR("NOW"), 3) == 0) {
+        trig = CAP_TRIG_NOW;
+    } else if (strncmp_P(arg, PSTR("MAX"), 3) == 0) {
+        trig = CAP_TRIG_OUT;
+        level = ((uint32_t)max_pwm * 1023 + 127) / 255; // OCR1A at the clamp
+    } else if (strncmp_P(arg, PSTR("RISE="), 5) == 0 || strncmp_P(arg, PSTR("FALL="), 5) == 0) {
+        int adc = atoi(arg + 5); // Checked before it is narrowed, -5 would arm at 65531
+        if (adc < 0 || adc > 1023) return PROTO_ERR_RANGE;
+        trig = arg[0] == 'R' ? CAP_TRIG_RISE : CAP_TRIG_FALL;
+        level = adc;
+    } else {
+        return PROTO_ERR_RANGE;
+    }
+    while ((arg = strchr(arg, ',')) != NULL) {
+        arg++;
+        if (*arg == 'D') decim = atoi(arg + 1);
+        else if (*arg == 'P') pre = atoi(arg + 1);
+        else return PROTO_ERR_RANGE;
+    }
+    if (decim < 1 || decim > 255 || pre < 0) return PROTO_ERR_RANGE;
+    return capture_arm(trig, level, decim, pre) ? PROTO_ERR_RANGE : 0;
 }
 
 // === UART Command Parser ===
-void process_uart_command(void) {
-    uart_send_string("Got: ");
-    uart_send_string((char*)uart_buffer);
-    uart_send_string("\r\n");
-
-    if (strncmp((char*)uart_buffer, "MIN:", 4) == 0) {
-        int value = atoi((char*)&uart_buffer[4]);
-        if (value < 0 || value > 255) {
-            uart_send_string("Error: MIN must be between 0 and 255!\r\n");
-        } else if (value >= temp_max_pwm) {
-            uart_send_string("Error: MIN cannot be >= MAX!\r\n");
+void process_uart_command(const char *cmd) {
+    uart_puts_P(PSTR("Got: "));
+    uart_send_string(cmd);
+    uart_puts_P(PSTR("\r\n"));
+
+    if (strncmp_P(cmd, PSTR("MIN:"), 4) == 0) {
+        uint8_t err = stage_min(atoi(&cmd[4]));
+        if (err == PROTO_ERR_RANGE) {
+            uart_puts_P(PSTR("Error: MIN must be between 0 and 255!\r\n"));
+        } else if (err == PROTO_ERR_CONFLICT) {
+            uart_puts_P(PSTR("Error: MIN cannot be >= MAX!\r\n"));
         } else {
-            temp_min_pwm = value;
-            uart_send_string("Temp MIN stored. Press button to apply.\r\n");
-            new_pwm_values_received = 1;
+            uart_puts_P(PSTR("Temp MIN stored. Press button to apply.\r\n"));
         }
     } 
-    else if (strncmp((char*)uart_buffer, "MAX:", 4) == 0) {
-        int value = atoi((char*)&uart_buffer[4]);
-        if (value < 0 || value > 255) {
-            uart_send_string("Error: MAX must be between 0 and 255!\r\n");
-        } else if (value <= temp_min_pwm) {
-            uart_send_string("Error: MAX cannot be <= MIN!\r\n");
+    else if (strncmp_P(cmd, PSTR("MAX:"), 4) == 0) {
+        uint8_t err = stage_max(atoi(&cmd[4]));
+        if (err == PROTO_ERR_RANGE) {
+            uart_puts_P(PSTR("Error: MAX must be between 0 and 255!\r\n"));
+        } else if (err == PROTO_ERR_CONFLICT) {
+            uart_puts_P(PSTR("Error: MAX cannot be <= MIN!\r\n"));
         } else {
-            temp_max_pwm = value;
-            uart_send_string("Temp MAX stored. Press button to apply.\r\n");
-            new_pwm_values_received = 1;
+            uart_puts_P(PSTR("Temp MAX stored. Press button to apply.\r\n"));
         }
     } 
+    else if (strncmp_P(cmd, PSTR("FILT:"), 5) == 0) {
+        // Takes effect at once, the ADC and PWM keep running
+        if (parse_filter(&cmd[5])) {
+            uart_puts_P(PSTR("Error: use FILT:OFF, FILT:OS<1-3> or FILT:IIR<1-6>, optional ,MED\r\n"));
+        } else {
+            report_filter();
+        }
+    }
+    else if (strncmp_P(cmd, PSTR("SCAN:"), 5) == 0) {
+        uint8_t sp_ch = pid.sp_ch;
+        if (parse_scan(&cmd[5])) {
+            uart_puts_P(PSTR("Error: use SCAN:<ch>,<ch>,... (up to 8 channels)\r\n"));
+        } else {
+            report_adc();
+            if (pid.sp_ch != sp_ch) report_pid(); // Setpoint channel dropped, now fixed
+        }
+    }
+    else if (strcmp_P(cmd, PSTR("ADC")) == 0) {
+        report_adc();
+    }
+    else if (strncmp_P(cmd, PSTR("CURVE:"), 6) == 0) {
+        if (parse_curve(&cmd[6])) {
+            uart_puts_P(PSTR("Error: use CURVE:LIN, LOG, GAM<10-50>, CUST or P<0-16>=<0-1023>\r\n"));
+        } else {
+            uart_puts_P(PSTR("Curve stored. Press button to apply.\r\n"));
+        }
+    }
+    else if (strcmp_P(cmd, PSTR("CAP:STOP")) == 0) {
+        capture_stop();
+        uart_puts_P(PSTR("Capture stopped.\r\n"));
+    }
+    else if (strncmp_P(cmd, PSTR("CAP:"), 4) == 0) {
+        if (parse_capture(&cmd[4])) {
+            uart_puts_P(PSTR("Error: use CAP:NOW, RISE=<0-1023>, FALL=<0-1023> or MAX, opt ,D<n> ,P<n>\r\n"));
+        } else {
+            uart_puts_P(PSTR("Capture armed, dumps when full.\r\n"));
+        }
+    }
+    else if (strcmp_P(cmd, PSTR("STATS")) == 0) {
+        prof_report();
+    }
+    else if (strcmp_P(cmd, PSTR("STATS:RESET")) == 0) {
+        prof_reset();
+        uart_puts_P(PSTR("Stats cleared.\r\n"));
+    }
+    else if (strncmp_P(cmd, PSTR("STATS:EVERY="), 12) == 0) {
+        int s = atoi(&cmd[12]);
+        if (s < 0 || s > SCHED_MAX_MS / 1000) {
+            uart_puts_P(PSTR("Error: use STATS:EVERY=<1-32> seconds, 0 to stop\r\n"));
+        } else {
+            sched_period(TASK_REPORT, (uint16_t)s * 1000u);
+            uart_puts_P(s ? PSTR("Periodic STATS on.\r\n") : PSTR("Periodic STATS off.\r\n"));
+        }
+    }
+    else if (strncmp_P(cmd, PSTR("FPS:"), 4) == 0) {
+        int hz = atoi(&cmd[4]);
+        if (hz < 1 || hz > 100) {
+            uart_puts_P(PSTR("Error: FPS must be between 1 and 100!\r\n"));
+        } else {
+            sched_period(TASK_DISPLAY, 1000 / hz);
+            uart_puts_P(PSTR("Display rate set.\r\n"));
+        }
+    }
+    else if (strcmp_P(cmd, PSTR("POWER")) == 0) {
+        power_report();
+    }
+    else if (strncmp_P(cmd, PSTR("POWER:DIM="), 10) == 0 || strncmp_P(cmd, PSTR("POWER:OFF="), 10) == 0) {
+        long s = atol(&cmd[10]);
+        uint8_t err = 1;
+        if (s >= 0 && s <= 3600) {
+            if (cmd[6] == 'D') err = power_set_timeouts(s, power_off_timeout());
+            else err = power_set_timeouts(power_dim_timeout(), s);
+        }
+        if (err) {
+            uart_puts_P(PSTR("Error: use POWER:DIM=<s> or POWER:OFF=<s> (0-3600, 0 = never, DIM <= OFF)\r\n"));
+        } else {
+            power_report();
+        }
+    }
+    else if (strncmp_P(cmd, PSTR("ADC:NR="), 7) == 0) {
+        int ch = atoi(&cmd[7]);
+        if (ch < 0 || ch >= ADC_CHANNELS) {
+            uart_puts_P(PSTR("Error: use ADC:NR=<channel>\r\n"));
+        } else {
+            uart_flush(); // The UART stops with the CPU clock
+            uint16_t value = adc_read_quiet(ch);
+            uart_puts_P(PSTR("ADC"));
+            uart_put_u32(ch);
+            uart_send('=');
+            uart_put_u32(value);
+            uart_puts_P(PSTR(" (quiet)\r\n"));
+        }
+    }
+    else if (strcmp_P(cmd, PSTR("PID")) == 0) {
+        report_pid();
+    }
+    else if (strncmp_P(cmd, PSTR("PID:"), 4) == 0) {
+        if (parse_pid(&cmd[4])) {
+            uart_puts_P(PSTR("Error: use PID:ON, OFF, KP/KI/KD=<0-127.99>, SP=<0-1023>, SP=A<ch in scan>, DIV=<1-255>\r\n"));
+        } else {
+            report_pid();
+        }
+    }
+    else if (strcmp_P(cmd, PSTR("BIN")) == 0) {
+        uart_puts_P(PSTR("Binary mode. Send op 0x7E to return to text.\r\n"));
+        proto_reset();
+        binary_mode = 1;
+    }
     else {
-        uart_send_string("Invalid UART command! Use MIN: or MAX:\r\n");
+        uart_puts_P(PSTR("Invalid UART command! Use MIN: or MAX:\r\n"));
     }
 }
 
+// === Binary Command Handler ===
+// Runs one operation, puts its result in out and returns 0 or a PROTO_ERR_ code
+uint8_t binary_op(uint8_t op, const uint8_t *in, uint8_t len, uint8_t *out, uint8_t *out_len) {
+    *out_len = 0;
+    switch (op) {
+        case PROTO_OP_PING:
+        case PROTO_OP_TEXT:
+            return 0;
+
+        case PROTO_OP_SET_MIN:
+            return len == 1 ? stage_min(in[0]) : PROTO_ERR_LEN;
+
+        case PROTO_OP_SET_MAX:
+            return len == 1 ? stage_max(in[0]) : PROTO_ERR_LEN;
+
+        case PROTO_OP_GET_PWM: {
+            uint16_t pwm = pwm_value; // Single read, the ADC ISR updates it
+            out[0] = pwm & 0xFF;
+            out[1] = pwm >> 8;
+            *out_len = 2;
+            return 0;
+        }
 
-// === FSM States ===
-typedef enum {
-    STATE_APPLY,
-    STATE_IDLE,
-    STATE_UART_RECEIVED,
-    STATE_UPDATE_DISPLAY
-} SystemState;
+        case PROTO_OP_SET_FILTER:
+            if (len != 3) return PROTO_ERR_LEN;
+            return filter_set(in[0], in[1], in[2] != 0) ? PROTO_ERR_RANGE : 0;
 
-// === Button Interrupt ===
-ISR(INT4_vect) {
-    button_flag = 1;
-}
+        case PROTO_OP_SET_CURVE:
+            return len == 2 ? stage_curve(in[0], in[1]) : PROTO_ERR_LEN;
 
-// === Main Function ===
-int main(void) {
-    // Initialize peripherals
-    timer1_pwm_init();
-    I2C_Init();
-    InitializeDisplay();
-    adc_init();
-    uart_init(MYUBRR);
-    clear_display();
-    sei(); // Enable global interrupts
+        case PROTO_OP_SET_POINTS:
+            // First point index, then u16 values little endian
+            if (len < 3 || !(len & 1)) return PROTO_ERR_LEN;
+            if (in[0] + (len - 1) / 2 > CURVE_POINTS) return PROTO_ERR_RANGE;
+            for (uint8_t i = 1; i < len; i += 2) {
+                if ((in[i] | in[i + 1] << 8) > 1023) return PROTO_ERR_RANGE;
+            }
+            for (uint8_t i = 1; i < len; i += 2) {
+                stage_point(in[0] + i / 2, in[i] | in[i + 1] << 8);
+            }
+            return 0;
+
+        case PROTO_OP_GET_CURVE:
+            out[0] = curve_type;
+            out[1] = curve_gamma;
+            out[2] = temp_curve_type;
+            out[3] = temp_curve_gamma;
+            *out_len = 4;
+            return 0;
+
+        case PROTO_OP_CAPTURE:
+            // trigger, level u16, decimation, pre-trigger u16; the dump follows as text + raw data
+            if (len != 6) return PROTO_ERR_LEN;
+            return capture_arm(in[0], in[1] | in[2] << 8, in[3], in[4] | in[5] << 8) ? PROTO_ERR_RANGE : 0;
+
+        case PROTO_OP_SET_PID:
+            // on, setpoint source, setpoint u16, kp/ki/kd u16 Q8.8, divider; applied at once
+            if (len != 11) return PROTO_ERR_LEN;
+            if (in[0] > 1 || in[10] == 0 || (in[5] | in[7] | in[9]) & 0x80) return PROTO_ERR_RANGE;
+            if (pid_set_setpoint(in[1], in[2] | in[3] << 8)) return PROTO_ERR_RANGE;
+            pid_set_gains(in[4] | in[5] << 8, in[6] | in[7] << 8, in[8] | in[9] << 8);
+            pid_set_div(in[10]);
+            pid_enable(in[0]);
+            return 0;
+
+        case PROTO_OP_GET_PID: {
+            int16_t v[4] = { pid.sp, pid.kp, pid.ki, pid.kd };
+            out[0] = pid.on;
+            out[1] = pid.sp_ch;
+            for (uint8_t i = 0; i < 4; i++) {
+                out[2 + 2 * i] = v[i] & 0xFF;
+                out[3 + 2 * i] = (uint16_t)v[i] >> 8;
+            }
+            out[10] = pid.div;
+            *out_len = 11;
+            return 0;
+        }
 
-    uart_send_string("Input values for minimun or max\r\n");
-    uart_send_string("Format: MIN:<value> or MAX:<value> (0 to 255)\r\n");
-    uart_send_string("Example: MIN:50 or MAX:200\r\n");
-
-
-    SystemState current_state = STATE_UPDATE_DISPLAY; // Start in display update state
-    char buffer1[20], buffer2[20]; // Buffers for display strings
-
-    while (1) {
-        switch (current_state) {
-            case STATE_APPLY:
-                // Wait for button to confirm changes
-                if (button_flag) {
-                    _delay_ms(100);
-                    button_flag = 0;
-
-                    if (new_pwm_values_received) {
-                        min_pwm = temp_min_pwm;
-                        max_pwm = temp_max_pwm;
-                        new_pwm_values_received = 0;
-                        ADCSRA |= (1 << ADSC); // Trigger ADC to apply new limits
-                        uart_send_string("MIN/MAX updated via button press.\r\n");
-                    }
-
-                    InitializeDisplay();
-                    clear_display();
-                    current_state = STATE_IDLE;
+        case PROTO_OP_SET_SCAN:
+            return set_scan(in, len);
+
+        case PROTO_OP_GET_ADC:
+            // Read the table one entry at a time, the ISR keeps writing it
+            for (uint8_t i = 0; i < adc_scan.n; i++) {
+                uint16_t value;
+                ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                    value = adc_result[adc_scan.list[i]];
                 }
-                break;
+                out[2 * i] = value & 0xFF;
+                out[2 * i + 1] = value >> 8;
+            }
+            *out_len = 2 * adc_scan.n;
+            return 0;
+
+        case PROTO_OP_GET_FILTER:
+            out[0] = adc_filter.mode;
+            out[1] = adc_filter.k;
+            out[2] = adc_filter.median != 0;
+            *out_len = 3;
+            return 0;
+
+        case PROTO_OP_GET_CONFIG:
+            out[0] = min_pwm;
+            out[1] = max_pwm;
+            out[2] = temp_min_pwm;
+            out[3] = temp_max_pwm;
+            out[4] = new_pwm_values_received;
+            *out_len = 5;
+            return 0;
+
+        default:
+            return PROTO_ERR_OP;
+    }
+}
 
-            case STATE_IDLE:
-                // Check for UART input or move to update
-                current_state = uart_rx_flag ? STATE_UART_RECEIVED : STATE_UPDATE_DISPLAY;
+// Answers one received frame with an ACK or NACK frame
+void process_binary_frame(const proto_frame_t *frame) {
+    uint8_t reply[PROTO_MAX_PAYLOAD];
+    uint8_t reply_len = 0;
+    uint8_t err = 0;
+
+    if (frame->op == PROTO_OP_BATCH) {
+        // Each operation is {op, len, payload}, each result {op|ACK or NACK, len, payload}
+        uint8_t pos = 0;
+        while (pos + 2 <= frame->len && !err) {
+            uint8_t op = frame->payload[pos];
+            uint8_t len = frame->payload[pos + 1];
+            uint8_t out[2 * ADC_SCAN_MAX]; // Largest single result (GET_ADC)
+            uint8_t out_len;
+
+            if (pos + 2 + len > frame->len) {
+                err = PROTO_ERR_LEN;
                 break;
-
-            case STATE_UART_RECEIVED:
-                uart_rx_flag = 0;
-                process_uart_command();
-                current_state = STATE_IDLE;
+            }
+            uint8_t op_err = op == PROTO_OP_BATCH || op == PROTO_OP_TEXT ? PROTO_ERR_OP
+                           : binary_op(op, &frame->payload[pos + 2], len, out, &out_len);
+            if (op_err) {
+                out[0] = op_err;
+                out_len = 1;
+            }
+            if (reply_len + 2 + out_len > PROTO_MAX_PAYLOAD) {
+                err = PROTO_ERR_LEN;
                 break;
+            }
+            reply[reply_len++] = op_err ? PROTO_NACK : op | PROTO_ACK;
+            reply[reply_len++] = out_len;
+            memcpy(&reply[reply_len], out, out_len);
+            reply_len += out_len;
+            pos += 2 + len;
+        }
+        if (!err && pos != frame->len) err = PROTO_ERR_LEN;
+    } else {
+        err = binary_op(frame->op, frame->payload, frame->len, reply, &reply_len);
+    }
 
-            case STATE_UPDATE_DISPLAY: {
-                // Convert 10-bit PWM to 8-bit and percentage
-                uint8_t display_pwm = ((uint32_t)pwm_value * 255 + 511) / 1023;
-                uint8_t percent = ((uint32_t)pwm_value * 100 + 511) / 1023;
+    if (err) {
+        proto_nack(frame->op, err);
+    } else {
+        proto_send(frame->op | PROTO_ACK, reply, reply_len);
+        if (frame->op == PROTO_OP_TEXT) binary_mode = 0;
+    }
+}
 
-                // Format strings
-                snprintf(buffer1, sizeof(buffer1), "Duty: %3u%%     ", percent);
-                snprintf(buffer2, sizeof(buffer2), "PWM:  %3u       ", display_pwm);
+// Bytes or lines waiting, depending on the command mode. Replies wait while a
+// capture dump has the UART at CAPTURE_BAUD
+uint8_t uart_input_pending(void) {
+    if (capture.state == CAP_DUMP) return 0;
+    return binary_mode ? uart_rx_available() : uart_lines_pending();
+}
 
-                char Set_Values[30];
-                if (new_pwm_values_received) {
-                    snprintf(Set_Values, sizeof(Set_Values), "Press button to set values");
-                } else {
-                    snprintf(Set_Values, sizeof(Set_Values), "Min:%3u Max:%3u", min_pwm, max_pwm);
-                }
 
-                // Blinking bar logic
-                static uint8_t blink = 0;
-                char bar[17];
-                uint8_t bar_length = (percent * 16) / 100;
-
-                for (uint8_t i = 0; i < 16; i++) {
-                    if (i < bar_length) {
-                        // Blink bar if at max
-                        if (display_pwm >= max_pwm) {
-                            bar[i] = blink ? 0xFF : ' ';
-                        } else {
-                            bar[i] = 0xFF;
-                        }
-                    } else {
-                        bar[i] = ' ';
-                    }
-                }
-                bar[16] = '\0';
-                blink = !blink; // Toggle for next frame
-
-                // Send text to OLED
-                sendStrXY(buffer2, 0, 0);
-                sendStrXY(buffer1, 1, 0);
-                sendStrXY(Set_Values, 6, 0);
-                sendStrXY(bar, 2, 0);
-
-                _delay_ms(10); // Frame delay
-
-                // State transitions
-                if (button_flag) {
-                    _delay_ms(100);
-                    current_state = STATE_APPLY;
-                } else if (uart_rx_flag) {
-                    current_state = STATE_UART_RECEIVED;
-                } else {
-                    current_state = STATE_IDLE;
-                }
+// === System Tick ===
+// Timer0 every 1 ms, samples the button
+ISR(TIMER0_COMPA_vect) {
+    PROF_SCOPE(PROF_ISR_TICK);
+    sched_tick();
+    button_tick();
+}
+
+// === Button Events ===
+// A click applies the staged values on release, a long press throws them away instead.
+// A press that switches the display back on does nothing else
+uint8_t button_long_seen = 0;
+uint8_t button_wake_only = 0;
+
+void apply_pending(void) {
+    if (!new_pwm_values_received) return;
+    min_pwm = temp_min_pwm;
+    max_pwm = temp_max_pwm;
+    curve_type = temp_curve_type;
+    curve_gamma = temp_curve_gamma;
+    new_pwm_values_received = 0;
+    // Entry by entry while the ADC keeps running, a gamma curve takes tens of ms
+    curve_build(curve_type, curve_gamma, min_pwm, max_pwm);
+    pid_limits(min_pwm, max_pwm);
+    uart_puts_P(PSTR("MIN/MAX updated via button press.\r\n"));
+}
+
+void revert_pending(void) {
+    if (!new_pwm_values_received) return;
+    temp_min_pwm = min_pwm;
+    temp_max_pwm = max_pwm;
+    temp_curve_type = curve_type;
+    temp_curve_gamma = curve_gamma;
+    new_pwm_values_received = 0;
+    uart_puts_P(PSTR("Pending values discarded (long press).\r\n"));
+}
+
+void handle_button_events(void) {
+    button_event_t event;
+    while ((event = button_event()) != BUTTON_NONE) {
+        if (event == BUTTON_PRESS && power_display() == POWER_OFF) button_wake_only = 1;
+        if (button_wake_only) {
+            if (event == BUTTON_RELEASE) button_wake_only = 0;
+            continue;
+        }
+        switch (event) {
+            case BUTTON_LONG:
+                revert_pending();
+                button_long_seen = 1;
+                break;
+            case BUTTON_RELEASE:
+                if (!button_long_seen) apply_pending();
+                button_long_seen = 0;
+                break;
+            default: // PRESS and DOUBLE do nothing here
                 break;
-            }
         }
     }
 }
+
+// === Display Pass ===
+// Numbers are fields that only resend the digits that changed, labels go out once
+#define PWM_TO_8BIT   FMT_RECIP(255, 1023)
+#define PWM_TO_PCT    FMT_RECIP(100, 1023)
+#define PWM_TO_BAR    FMT_RECIP(SSD1306_LCDWIDTH, 1023)
+
+field_t pwm_field = { .row = 0, .col = 6, .width = 3 };
+field_t duty_field = { .row = 1, .col = 6, .width = 3 };
+field_t min_field = { .row = 6, .col = 4, .width = 3 };
+field_t max_field = { .row = 6, .col = 12, .width = 3 };
+bar_t pwm_bar = { .page = 2, .x = 0, .width = SSD1306_LCDWIDTH };
+
+typedef enum {
+    LAYOUT_BLANK,      // Display just cleared
+    LAYOUT_MINMAX,     // Min/Max on the bottom rows
+    LAYOUT_PENDING     // "Press button" message instead
+} ScreenLayout;
+ScreenLayout screen_layout = LAYOUT_BLANK;
+
+uint8_t blink_phase = 0; // Toggled by the blink task
+
+// Call after clear_display() so the next pass draws everything
+void invalidate_display(void) {
+    screen_layout = LAYOUT_BLANK;
+    field_invalidate(&pwm_field);
+    field_invalidate(&duty_field);
+    field_invalidate(&min_field);
+    field_invalidate(&max_field);
+    bar_invalidate(&pwm_bar);
+}
+
+// Draws one frame of the status screen, a function of its own so benchmarks can time it
+void update_display(void) {
+    uint16_t pwm = pwm_value;
+    power_input(pwm); // A large input change counts as activity
+    if (power_display() == POWER_OFF) return; // The panel keeps its RAM, fields stay valid
+
+    PROF_START(t_format);
+    // Convert 10-bit PWM to 8-bit and percentage
+    uint8_t display_pwm = fmt_scale(pwm, PWM_TO_8BIT);
+    uint8_t percent = fmt_scale(pwm, PWM_TO_PCT);
+
+    uint8_t bar_length = fmt_scale(pwm, PWM_TO_BAR); // One pixel column per step
+
+    // Blink the bar at max by inverting it, the blink task sets the pace
+    uint8_t blink = display_pwm >= max_pwm && blink_phase;
+    PROF_STOP(PROF_FORMAT, t_format);
+
+    PROF_START(t_draw);
+    ScreenLayout layout = new_pwm_values_received ? LAYOUT_PENDING : LAYOUT_MINMAX;
+    if (screen_layout == LAYOUT_BLANK) {
+        widget_text_P(PSTR("PWM:"), 0, 0);
+        widget_text_P(PSTR("Duty:"), 1, 0);
+        widget_text_P(PSTR("%"), 1, 9);
+    }
+    if (layout != screen_layout) {
+        if (layout == LAYOUT_PENDING) {
+            widget_text_P(PSTR("Press button to set values"), 6, 0); // Runs on into row 7
+        } else {
+            if (screen_layout == LAYOUT_PENDING) widget_text_P(PSTR("          "), 7, 0);
+            widget_text_P(PSTR("Min:    Max:    "), 6, 0);
+            field_invalidate(&min_field);
+            field_invalidate(&max_field);
+        }
+        screen_layout = layout;
+    }
+
+    field_draw(&pwm_field, display_pwm);
+    field_draw(&duty_field, percent);
+    if (layout == LAYOUT_MINMAX) {
+        field_draw(&min_field, min_pwm);
+        field_draw(&max_field, max_pwm);
+    }
+    bar_draw(&pwm_bar, bar_length, blink);
+
+#ifdef SSD1306_FRAMEBUFFER
+    // Flush sends what changed and swaps frames. While the last frame is still
+    // on the bus it returns 0 and the next pass draws a fresher one
+    ssd1306_flush();
+#endif
+    PROF_STOP(PROF_DRAW, t_draw);
+}
+
+// === Task Bodies ===
+// Work through every queued line or frame, a host may send several at once
+void uart_task(void) {
+    power_activity();
+    if (binary_mode) {
+        int16_t c;
+        while (binary_mode && (c = uart_getc()) >= 0) {
+            uint8_t result = proto_feed(&rx_frame, c);
+            if (result == PROTO_FRAME) process_binary_frame(&rx_frame);
+            else if (result == PROTO_BAD_CRC) proto_nack(rx_frame.op, PROTO_ERR_CRC);
+        }
+    } else {
+        while (!binary_mode && uart_read_line(uart_line, sizeof(uart_line))) {
+            process_uart_command(uart_line);
+        }
+    }
+    sched_after(TASK_DISPLAY, 0); // Show staged values without waiting for the period
+}
+
+// Debounced by the tick, the events are final. The display keeps its content,
+// the next pass swaps the bottom rows and resends what changed
+void button_task(void) {
+    handle_button_events(); // Before power_activity() so a press can tell the display was off
+    power_activity();
+    sched_after(TASK_DISPLAY, 0);
+}
+
+// Button events print, they wait for a capture dump like the UART replies
+uint8_t button_ready(void) {
+    return capture.state != CAP_DUMP && button_pending();
+}
+
+uint8_t capture_ready(void) {
+    return capture.state == CAP_DONE;
+}
+
+// A finished capture goes out in steps, the other tasks keep running in between
+void capture_task(void) {
+    uint8_t ms = capture_dump(MYUBRR);
+    if (ms) sched_after(TASK_CAPTURE, ms);
+}
+
+// Periodic STATS, skipped while a capture dump has the UART
+void report_task(void) {
+    if (capture.state != CAP_DUMP) prof_report();
+}
+
+void blink_task(void) {
+    blink_phase = !blink_phase;
+}
+
+const sched_task_t task_table[TASK_COUNT] = {
+    [TASK_BUTTON]  = { button_task, button_ready, 0, PROF_BUTTON },
+    [TASK_UART]    = { uart_task, uart_input_pending, 0, PROF_UART },
+    [TASK_CAPTURE] = { capture_task, capture_ready, 0, PROF_CAPTURE },
+    [TASK_DISPLAY] = { update_display, 0, 1000 / DISPLAY_HZ, PROF_DISPLAY },
+    [TASK_BLINK]   = { blink_task, 0, BLINK_MS, PROF_BLINK },
+    [TASK_REPORT]  = { report_task, 0, 0, PROF_REPORT }, // STATS:EVERY=<s> starts it
+    [TASK_POWER]   = { power_second, 0, 1000, PROF_POWER },
+};
+
+// === Main Function ===
+// Everything up to the scheduler, the native tests boot the firmware with it
+void app_init(void) {
+    // Initialize peripherals
+    prof_init();
+    PROF_START(t_boot); // Boot time shows up as BOOT in STATS
+    hal_tick_init();
+    timer1_pwm_init();
+    curve_build(curve_type, curve_gamma, min_pwm, max_pwm); // Before the ADC ISR reads it
+    I2C_Init();
+    uint16_t oled_ms = I2C_WaitReady(_i2c_address, OLED_BOOT_TIMEOUT_MS);
+    I2C_ProbeSpeed(_i2c_address); // Run the OLED bus as fast as the display still acks
+    InitializeDisplay(); // One command transaction
+    adc_init();
+    uart_init(MYUBRR);
+    button_init();
+    power_init();
+    clear_display();
+    sei(); // Enable global interrupts
+    I2C_Wait(); // Display set up and blank
+    PROF_STOP(PROF_BOOT, t_boot);
+
+    uart_puts_P(PSTR("Input values for minimun or max\r\n"));
+    uart_puts_P(PSTR("Format: MIN:<value> or MAX:<value> (0 to 255)\r\n"));
+    uart_puts_P(PSTR("Example: MIN:50 or MAX:200\r\n"));
+    uart_puts_P(PSTR("Inputs: SCAN:0,1,... (first drives PWM), ADC to read them\r\n"));
+    uart_puts_P(PSTR("Curve: CURVE:LIN, LOG, GAM22, CUST, CURVE:P<n>=<v> for custom points\r\n"));
+    uart_puts_P(PSTR("Capture: CAP:NOW, CAP:RISE=<adc>, CAP:MAX (,D<n> ,P<n>), CAP:STOP\r\n"));
+    uart_puts_P(PSTR("Filter: FILT:OFF, FILT:OS<1-3>, FILT:IIR<1-6>, add ,MED for spikes\r\n"));
+    uart_puts_P(PSTR("Button: click applies pending values, hold it to discard them\r\n"));
+    uart_puts_P(PSTR("Timing: STATS, STATS:RESET, STATS:EVERY=<s>, FPS:<1-100> display rate\r\n"));
+    uart_puts_P(PSTR("PID: PID:ON/OFF, PID:KP=1.5, KI=, KD=, SP=<0-1023> or SP=A<ch>, DIV=<n>\r\n"));
+    uart_puts_P(PSTR("Power: POWER, POWER:DIM=<s>, POWER:OFF=<s> (0 = never), ADC:NR=<ch> quiet read\r\n"));
+
+    uart_puts_P(PSTR("OLED I2C: "));
+    uart_put_u32(I2C_SpeedKHz(I2C_GetSpeed()));
+    uart_puts_P(PSTR(" kHz, ready after "));
+    uart_put_u32(oled_ms);
+    uart_puts_P(PSTR(" ms\r\n"));
+
+    sched_init(task_table, TASK_COUNT);
+}
+
+#ifndef PIO_UNIT_TESTING // The test runner brings its own main()
+int main(void) {
+    app_init();
+    sched_run(); // Never returns
+}
+#endif
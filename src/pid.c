@@ -0,0 +1,128 @@
+/*
+ * pid.c
+ * loop step and settings for pid.h, integer math only
+ */
+#include "hal.h"
+#include "adc.h"
+#include "prof.h"
+#include "pid.h"
+
+pid_ctrl_t pid={ .sp_ch=PID_SP_FIXED, .sp=512, .kp=256, .ki=8, .div=8, .out_max=1023 };
+
+/** Start from the output that is on the pin, with the integral holding it*/
+void pid_enable(uint8_t on)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if(on && !pid.on){
+			pid.out=hal_pwm_get();
+			if(pid.out<pid.out_min) pid.out=pid.out_min;
+			if(pid.out>pid.out_max) pid.out=pid.out_max;
+			pid.integ=(int32_t)pid.out<<PID_Q;
+			pid.count=0;
+			pid.fresh=1;
+		}
+		pid.on=on;
+	}
+}
+
+void pid_limits(uint8_t min_pwm, uint8_t max_pwm)
+{
+	uint16_t lo=((uint32_t)min_pwm*1023+127)/255;
+	uint16_t hi=((uint32_t)max_pwm*1023+127)/255;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		pid.out_min=lo;
+		pid.out_max=hi;
+	}
+}
+
+uint8_t pid_set_gains(int16_t kp, int16_t ki, int16_t kd)
+{
+	if(kp<0 || ki<0 || kd<0) return 1;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		pid.kp=kp;
+		pid.ki=ki;
+		pid.kd=kd;
+	}
+	return 0;
+}
+
+uint8_t pid_set_setpoint(uint8_t ch, uint16_t sp)
+{
+	uint8_t i;
+
+	if(ch!=PID_SP_FIXED){
+		for(i=0;i<adc_scan.n && adc_scan.list[i]!=ch;i++);
+		if(i==adc_scan.n) return 1;
+	}else if(sp>1023){
+		return 1;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		pid.sp_ch=ch;
+		if(ch==PID_SP_FIXED) pid.sp=sp;
+	}
+	return 0;
+}
+
+/** The setpoint channel is no longer converted: keep its last value as a fixed
+* setpoint instead of following a result that does not change any more*/
+void pid_scan_changed(void)
+{
+	uint8_t i;
+
+	if(pid.sp_ch==PID_SP_FIXED) return;
+	for(i=0;i<adc_scan.n;i++)
+	{
+		if(adc_scan.list[i]==pid.sp_ch) return;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		pid.sp=adc_result[pid.sp_ch];
+		pid.sp_ch=PID_SP_FIXED;
+	}
+}
+
+uint8_t pid_set_div(uint8_t div)
+{
+	if(!div) return 1;
+	pid.div=div;		/* single byte, pid_due() sees the old or the new one */
+	return 0;
+}
+
+/** Runs in ISR(ADC_vect). y and e are in 12-bit codes, 4 per 10-bit code, so the
+* Q8.8 gains give OCR1A in Q10. The limits are in Q10 too, so the integral and
+* the sum are clamped without a shift, the output is rounded once at the end.*/
+uint16_t pid_step(uint16_t y)
+{
+	PROF_SCOPE(PROF_PID);
+	int32_t lo=(int32_t)pid.out_min<<PID_Q, hi=(int32_t)pid.out_max<<PID_Q;
+	uint16_t sp=pid.sp_ch==PID_SP_FIXED?pid.sp:adc_result[pid.sp_ch];
+	int16_t e=(int16_t)(sp<<2)-(int16_t)y;
+	int32_t i,u;
+
+	if(pid.fresh){
+		pid.y_prev=y;
+		pid.fresh=0;
+	}
+	i=pid.integ+(int32_t)pid.ki*e;
+	if(i>hi) i=hi;
+	else if(i<lo) i=lo;
+	u=(int32_t)pid.kp*e+i-(int32_t)pid.kd*((int16_t)y-(int16_t)pid.y_prev);
+	pid.y_prev=y;
+
+	if(u>=hi){				/* saturated: the integral may only move back */
+		u=hi;
+		if(e<0) pid.integ=i;
+	}else if(u<=lo){
+		u=lo;
+		if(e>0) pid.integ=i;
+	}else{
+		pid.integ=i;
+	}
+	pid.out=(u+(1<<(PID_Q-1)))>>PID_Q;
+	return pid.out;
+}
@@ -0,0 +1,71 @@
+/*
+ * pid.h
+ * closed loop mode: fixed point PID between the ADC and OCR1A
+ *
+ * the first channel of the scan list is the feedback, after adc_filter. the setpoint
+ * is a fixed value (PID:SP=<0-1023>) or the last result of another channel in the
+ * scan list. the output stays within the MIN/MAX clamp like the open loop curve.
+ *
+ * the loop runs in ISR(ADC_vect) on every div-th filtered feedback sample. the ADC is
+ * started by the Timer1 overflow, so the loop period is fixed by Timer1:
+ *   2046 cycles (7820 Hz) * scan length * oversampling block (4^k) * div
+ * and the gains are per loop period, no dt in the arithmetic.
+ *
+ * gains are Q8.8 (256 = 1.0, 0..32767) per 10-bit ADC code, e = setpoint - feedback:
+ *   u = kp*e + sum(ki*e) - kd*(y - y_prev)
+ * the feedback is the 12-bit adc_filter output, so the loop sees the extra bits of
+ * oversampling and the IIR; with e in 12-bit codes the products come out in Q10.
+ * the derivative acts on the measurement so a setpoint step gives no kick.
+ * anti-windup: the integral is limited to the output range and holds while the
+ * output is saturated in the direction of the error.
+ *
+ * cycle budget at 16 MHz: three 16x16->32 multiplies and 32-bit compares per step.
+ * measured as "pid_step" in the function_cycles of the simavr bench (exact, PID:ON for
+ * 200 ms) and on a board as the PID probe in STATS (4 us = 64 cycles resolution).
+ */
+
+
+#ifndef PID_H_
+#define PID_H_
+
+#include <stdint.h>
+
+#define PID_SP_FIXED	0xFF	/* setpoint source: pid.sp */
+#define PID_Q			10		/* fraction bits of integ and the sum: Q8.8 gain * 12-bit code */
+
+typedef struct {
+	uint8_t on;
+	uint8_t sp_ch;			/* setpoint channel or PID_SP_FIXED */
+	uint16_t sp;			/* fixed setpoint 0..1023 */
+	int16_t kp, ki, kd;		/* Q8.8 */
+	uint8_t div;			/* loop step every div-th feedback sample */
+	uint8_t count;
+	uint8_t fresh;			/* 1 = first step after PID:ON, no derivative */
+	uint16_t out_min, out_max;	/* OCR1A clamp */
+	uint16_t out;			/* last output, held between steps */
+	uint16_t y_prev;		/* 12-bit */
+	int32_t integ;			/* integral in OCR1A units, Q10 */
+} pid_ctrl_t;
+
+extern pid_ctrl_t pid;
+
+void pid_enable(uint8_t on);			/* starts from the current OCR1A, no bump */
+void pid_limits(uint8_t min_pwm, uint8_t max_pwm);	/* MIN/MAX as for curve_build() */
+uint8_t pid_set_gains(int16_t kp, int16_t ki, int16_t kd);	/* 0 or 1 on a negative gain */
+uint8_t pid_set_setpoint(uint8_t ch, uint16_t sp);	/* 0 or 1, ch must be in the scan list */
+uint8_t pid_set_div(uint8_t div);		/* 0 or 1 for div 0 */
+void pid_scan_changed(void);			/* after adc_set_scan(): a dropped setpoint channel becomes fixed */
+
+/** loop step for the 12-bit feedback y (0..4092), returns the new OCR1A value. kept out of
+* line, even with LTO, so the bench finds it by its symbol*/
+uint16_t pid_step(uint16_t y) __attribute__((noinline));
+
+/** For ISR(ADC_vect) on each filtered feedback sample: 1 when this one runs a step*/
+static inline uint8_t pid_due(void)
+{
+	if(++pid.count<pid.div) return 0;
+	pid.count=0;
+	return 1;
+}
+
+#endif /* PID_H_ */
@@ -0,0 +1,140 @@
+/*
+ * power.c
+ * display dim/off on idle time, the current estimate of power_report()
+ */
+#include "hal.h"
+#include "ssd1306.h"
+#include "sched.h"
+#include "uart.h"
+#include "power.h"
+
+#define POWER_CONTRAST	0xCF	/* contrast of the init sequence */
+
+static power_display_t power_state;
+static uint16_t power_idle_s;			/* seconds since the last activity */
+static uint16_t power_dim_s=POWER_DIM_S, power_off_s=POWER_OFF_S;
+static uint16_t power_ref;				/* input at the last activity */
+static uint32_t power_slept;			/* sched_sleep_ticks() a second ago */
+static uint16_t power_sleep_pm;			/* per mille of the last second spent asleep */
+
+void power_init(void)
+{
+	power_slept=sched_sleep_ticks();
+}
+
+void power_activity(void)
+{
+	power_idle_s=0;
+	if(power_state==POWER_OFF) displayOn();
+	if(power_state!=POWER_ON) dim(false);
+	power_state=POWER_ON;
+}
+
+void power_input(uint16_t value)
+{
+	uint16_t d=value>power_ref?value-power_ref:power_ref-value;
+	if(d<POWER_WAKE_DELTA) return;
+	power_ref=value;
+	power_activity();
+}
+
+void power_second(void)
+{
+	uint32_t slept=sched_sleep_ticks();
+	uint32_t d=slept-power_slept;
+
+	power_slept=slept;
+	power_sleep_pm=d>=250000UL?1000:d/250;	/* 250000 ticks of 4 us per second */
+
+	if(power_idle_s<0xFFFF) power_idle_s++;
+	if(power_off_s && power_idle_s>=power_off_s){
+		if(power_state!=POWER_OFF) displayOff();
+		power_state=POWER_OFF;
+	}else if(power_dim_s && power_idle_s>=power_dim_s && power_state==POWER_ON){
+		dim(true);
+		power_state=POWER_DIM;
+	}
+}
+
+power_display_t power_display(void)
+{
+	return power_state;
+}
+
+uint16_t power_dim_timeout(void)
+{
+	return power_dim_s;
+}
+
+uint16_t power_off_timeout(void)
+{
+	return power_off_s;
+}
+
+uint8_t power_set_timeouts(uint16_t dim_s, uint16_t off_s)
+{
+	if(dim_s && off_s && dim_s>off_s) return 1;
+	power_dim_s=dim_s;
+	power_off_s=off_s;
+	power_activity();
+	return 0;
+}
+
+/** lit pixels in per mille*/
+static uint16_t power_lit_pm(void)
+{
+#ifdef SSD1306_FRAMEBUFFER
+	uint32_t lit=0;
+	uint16_t i;
+	uint8_t b;
+
+	for(i=0;i<SSD1306_BUFSIZE;i++)
+	{
+		for(b=ssd1306_buffer[i];b;b&=b-1) lit++;	/* the back frame matches the display after a flush */
+	}
+	return lit*1000/(SSD1306_BUFSIZE*8UL);
+#else
+	return POWER_OLED_LIT*10;
+#endif
+}
+
+/** per mille as a percentage with one decimal*/
+static void power_put_pm(uint16_t pm)
+{
+	uart_put_u32(pm/10);
+	uart_send('.');
+	uart_put_u32(pm%10);
+	uart_send('%');
+}
+
+void power_report(void)
+{
+	static const char names[3][4]={ "on", "dim", "off" };
+	uint16_t lit=power_lit_pm();
+	uint32_t mcu=POWER_MCU_ACTIVE_UA-(uint32_t)(POWER_MCU_ACTIVE_UA-POWER_MCU_IDLE_UA)*power_sleep_pm/1000;
+	uint32_t oled;
+
+	if(power_state==POWER_OFF) oled=POWER_OLED_OFF_UA;
+	else oled=POWER_OLED_BASE_UA+(uint32_t)POWER_OLED_FULL_UA*lit/1000*
+		(power_state==POWER_DIM?1:POWER_CONTRAST)/POWER_CONTRAST;
+
+	uart_puts_P(PSTR("POWER display="));
+	uart_send_string(names[power_state]);
+	uart_puts_P(PSTR(" idle="));
+	uart_put_u32(power_idle_s);
+	uart_puts_P(PSTR("s dim="));
+	uart_put_u32(power_dim_s);
+	uart_puts_P(PSTR("s off="));
+	uart_put_u32(power_off_s);
+	uart_puts_P(PSTR("s\r\nMCU asleep "));
+	power_put_pm(power_sleep_pm);
+	uart_puts_P(PSTR(" ~"));
+	uart_put_u32(mcu);
+	uart_puts_P(PSTR(" uA, OLED "));
+	power_put_pm(lit);
+	uart_puts_P(PSTR(" lit ~"));
+	uart_put_u32(oled);
+	uart_puts_P(PSTR(" uA, total ~"));
+	uart_put_u32(mcu+oled);
+	uart_puts_P(PSTR(" uA (estimate)\r\n"));
+}
@@ -0,0 +1,46 @@
+/*
+ * power.h
+ * display power management and a supply current estimate for the POWER command.
+ * after dim_s seconds without activity (button, UART, a large input change) the
+ * display drops to the lowest contrast, after off_s it is switched off (panel in
+ * sleep, RAM kept). activity brings it back at once.
+ *
+ * the board has no current sensor: the figures below are typical values, measure
+ * a unit and adjust them. the MCU part is weighted by the time spent in idle sleep,
+ * the panel part by the lit pixels (framebuffer builds) and the contrast.
+ */
+
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdint.h>
+
+#define POWER_DIM_S			30		/* defaults, 0 = never */
+#define POWER_OFF_S			120
+#define POWER_WAKE_DELTA	64		/* input change (0-1023) that counts as activity */
+
+#define POWER_MCU_ACTIVE_UA	15000	/* ATmega2560 at 16 MHz, 5 V, running */
+#define POWER_MCU_IDLE_UA	5000	/* same in idle sleep */
+#define POWER_OLED_BASE_UA	500		/* controller and charge pump, dark panel */
+#define POWER_OLED_FULL_UA	20000	/* every pixel lit at contrast 0xCF */
+#define POWER_OLED_OFF_UA	10		/* display off */
+#define POWER_OLED_LIT		25		/* % lit pixels assumed without a framebuffer */
+
+typedef enum {
+	POWER_ON,
+	POWER_DIM,
+	POWER_OFF
+} power_display_t;
+
+void power_init(void);
+void power_activity(void);		/* display back to full brightness, idle time restarts */
+void power_input(uint16_t value);	/* activity when value moved by POWER_WAKE_DELTA */
+void power_second(void);		/* from a 1 s task: timeouts and the sleep share */
+power_display_t power_display(void);
+uint16_t power_dim_timeout(void);
+uint16_t power_off_timeout(void);
+uint8_t power_set_timeouts(uint16_t dim_s, uint16_t off_s);	/* 0 or 1 when dim_s > off_s */
+void power_report(void);		/* POWER status line over the UART */
+
+#endif /* POWER_H_ */
@@ -0,0 +1,83 @@
+/*
+ * prof.c
+ * probe table and the STATS report, recording is inline in prof.h
+ */
+#include <string.h>
+#include "prof.h"
+#include "uart.h"
+
+#if PROF_ENABLE
+prof_probe_t prof[PROF_COUNT];
+
+static const char prof_names[PROF_COUNT][8] PROGMEM = {
+	"BUTTON", "UART", "CAPTURE", "DISPLAY", "BLINK", "REPORT", "POWER", "SLEEP", "LATE",
+	"FORMAT", "DRAW", "I2CWAIT", "TXWAIT", "BOOT", "PID",
+	"ADC", "RX", "UDRE", "TWI", "TICK"
+};
+#endif
+
+/** start Timer5 and clear the table*/
+void prof_init(void)
+{
+#if PROF_ENABLE
+	hal_prof_init();
+	prof_reset();
+#endif
+}
+
+void prof_reset(void)
+{
+#if PROF_ENABLE
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for(uint8_t i=0;i<PROF_COUNT;i++)
+		{
+			memset(&prof[i],0,sizeof(prof[i]));
+			prof[i].min=0xFFFF;
+		}
+	}
+#endif
+}
+
+/** "NAME n=<total> min=<us> avg=<us> max=<us> |<from us>:<count> ...", empty bins left out.
+* a histogram entry counts the times from its value up to just under twice that*/
+void prof_report(void)
+{
+#if PROF_ENABLE
+	prof_probe_t p;
+	char name[8];
+
+	uart_puts_P(PSTR("STATS us, 4 us per tick\r\n"));
+	for(uint8_t i=0;i<PROF_COUNT;i++)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)	/* ISR probes keep counting */
+		{
+			p=prof[i];
+		}
+		if(!p.total) continue;
+		memcpy_P(name,prof_names[i],sizeof(name));
+		uart_send_string(name);
+		for(uint8_t n=strlen(name);n<7;n++) uart_send(' ');	/* names left aligned in 7 */
+		uart_puts_P(PSTR(" n="));
+		uart_put_u32(p.total);
+		uart_puts_P(PSTR(" min="));
+		uart_put_u32((uint32_t)p.min*PROF_TICK_US);
+		uart_puts_P(PSTR(" avg="));
+		uart_put_u32(p.sum*PROF_TICK_US/p.n);
+		uart_puts_P(PSTR(" max="));
+		uart_put_u32((uint32_t)p.max*PROF_TICK_US);
+		uart_puts_P(PSTR(" |"));
+		for(uint8_t b=0;b<PROF_BINS;b++)
+		{
+			if(!p.hist[b]) continue;
+			uart_send(' ');
+			uart_put_u32(b?(uint32_t)PROF_TICK_US<<(b-1):0);
+			uart_send(':');
+			uart_put_u32(p.hist[b]);
+		}
+		uart_puts_P(PSTR("\r\n"));
+	}
+#else
+	uart_puts_P(PSTR("STATS: built with PROF_ENABLE=0\r\n"));
+#endif
+}
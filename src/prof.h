@@ -0,0 +1,117 @@
+/*
+ * prof.h
+ * time spent in code blocks, measured on Timer5 running free at clk/64 (4 us per tick,
+ * wraps after 262 ms). every probe keeps count, min, max, mean and a log2 histogram,
+ * STATS prints the table over the UART and STATS:RESET clears it.
+ *
+ *   PROF_START(t) ... PROF_STOP(p, t)   around a block, t is a local holding the start tick
+ *   PROF_SCOPE(p)                       from here to the end of the enclosing block, every return included
+ *
+ * a probe belongs to one context (the main loop or one ISR), so recording needs no lock.
+ * main loop probes include the ISRs that ran meanwhile. -DPROF_ENABLE=0 compiles the
+ * probes out.
+ */
+
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <stdint.h>
+#include "hal.h"
+
+#ifndef PROF_ENABLE
+#define PROF_ENABLE		1
+#endif
+
+#define PROF_TICK_US	4		/* hal_prof_now() resolution */
+#define PROF_BINS		17		/* bin 0: 0 ticks, bin k: 2^(k-1) to 2^k-1 ticks */
+
+/** probes*/
+enum {
+	PROF_BUTTON,				/* one run of each scheduler task in main.c */
+	PROF_UART,
+	PROF_CAPTURE,
+	PROF_DISPLAY,
+	PROF_BLINK,
+	PROF_REPORT,
+	PROF_POWER,
+	PROF_SLEEP,					/* idle sleep until the next interrupt */
+	PROF_LATE,					/* how long a due task waited, at 1 ms resolution */
+	PROF_FORMAT,				/* number formatting of a display pass */
+	PROF_DRAW,					/* queueing the text for the display */
+	PROF_I2C_WAIT,				/* stalls on a full I2C ring or I2C_Wait() */
+	PROF_TX_WAIT,				/* stalls on a full UART TX ring or uart_flush() */
+	PROF_BOOT,					/* reset to a blank display and sei(), once */
+	PROF_PID,					/* one PID loop step, inside the ADC interrupt */
+	PROF_ISR_ADC,
+	PROF_ISR_RX,
+	PROF_ISR_UDRE,
+	PROF_ISR_TWI,
+	PROF_ISR_TICK,
+	PROF_COUNT
+};
+
+typedef struct {
+	uint16_t min, max;			/* ticks */
+	uint16_t n;					/* samples in sum, both halve when n would overflow */
+	uint32_t sum;
+	uint32_t total;				/* samples since the last reset */
+	uint8_t hist[PROF_BINS];	/* all bins halve when one would overflow, so past */
+} prof_probe_t;					/* 255 the counts show the shape, n= gives the total */
+
+void prof_init(void);
+void prof_reset(void);
+void prof_report(void);			/* one line per probe that has samples, times in us */
+
+#if PROF_ENABLE
+
+extern prof_probe_t prof[PROF_COUNT];
+
+static inline void prof_record(uint8_t probe, uint16_t ticks)
+{
+	prof_probe_t *p=&prof[probe];
+	uint8_t bin=0;
+	uint16_t t=ticks;
+
+	while(t){
+		t>>=1;
+		bin++;
+	}
+	if(p->hist[bin]==0xFF){
+		for(uint8_t i=0;i<PROF_BINS;i++) p->hist[i]>>=1;
+	}
+	p->hist[bin]++;
+	if(p->n==0xFFFF){
+		p->n>>=1;
+		p->sum>>=1;
+	}
+	p->n++;
+	p->sum+=ticks;
+	p->total++;
+	if(ticks<p->min) p->min=ticks;
+	if(ticks>p->max) p->max=ticks;
+}
+
+typedef struct {
+	uint8_t probe;
+	uint16_t start;
+} prof_span_t;
+
+static inline void prof_span_end(prof_span_t *span)
+{
+	prof_record(span->probe,hal_prof_now()-span->start);
+}
+
+#define PROF_START(t)		uint16_t t=hal_prof_now()
+#define PROF_STOP(p, t)		prof_record((p),hal_prof_now()-(t))
+#define PROF_SCOPE(p)		prof_span_t prof_span __attribute__((__cleanup__(prof_span_end)))={ (p), hal_prof_now() }
+
+#else
+
+#define PROF_START(t)
+#define PROF_STOP(p, t)		((void)(p))
+#define PROF_SCOPE(p)
+
+#endif
+
+#endif /* PROF_H_ */
@@ -0,0 +1,95 @@
+/*
+ * proto.c
+ * binary frame parser and writer, see proto.h for the frame layout.
+ * The parser hunts for the sync byte, so garbage between frames is skipped.
+ */
+#include "proto.h"
+#include "uart.h"
+#include "hal.h"
+
+#define PROTO_HUNT	0	/* waiting for PROTO_SYNC */
+#define PROTO_OPC	1
+#define PROTO_LEN	2
+#define PROTO_DATA	3
+#define PROTO_CRC	4
+
+static uint8_t proto_state=PROTO_HUNT;
+static uint8_t proto_pos;
+
+/** CRC-8, polynomial x^8+x^2+x+1 (0x07)*/
+uint8_t proto_crc8(uint8_t crc, const uint8_t *data, uint8_t len)
+{
+	while(len--)
+	crc=_crc8_ccitt_update(crc,*data++);
+	return crc;
+}
+
+void proto_reset(void)
+{
+	proto_state=PROTO_HUNT;
+}
+
+/** Feed one received byte. Returns PROTO_FRAME when *frame holds a complete frame with a
+* good CRC, PROTO_BAD_CRC when a complete frame failed the check, PROTO_MORE otherwise.
+* A length above PROTO_MAX_PAYLOAD can not be a frame, the parser goes back to hunting.*/
+uint8_t proto_feed(proto_frame_t *frame, uint8_t byte)
+{
+	uint8_t crc;
+
+	switch(proto_state)
+	{
+		case PROTO_HUNT:
+		if(byte==PROTO_SYNC) proto_state=PROTO_OPC;
+		break;
+
+		case PROTO_OPC:
+		frame->op=byte;
+		proto_state=PROTO_LEN;
+		break;
+
+		case PROTO_LEN:
+		if(byte>PROTO_MAX_PAYLOAD){
+			proto_state=(byte==PROTO_SYNC)?PROTO_OPC:PROTO_HUNT;
+			break;
+		}
+		frame->len=byte;
+		proto_pos=0;
+		proto_state=byte?PROTO_DATA:PROTO_CRC;
+		break;
+
+		case PROTO_DATA:
+		frame->payload[proto_pos++]=byte;
+		if(proto_pos==frame->len) proto_state=PROTO_CRC;
+		break;
+
+		case PROTO_CRC:
+		proto_state=PROTO_HUNT;
+		crc=_crc8_ccitt_update(_crc8_ccitt_update(0,frame->op),frame->len);
+		if(proto_crc8(crc,frame->payload,frame->len)!=byte)
+		return PROTO_BAD_CRC;
+		return PROTO_FRAME;
+	}
+	return PROTO_MORE;
+}
+
+/** queue one frame on the UART with a single uart_write(), so with UART_TX_DROP
+* a frame is either queued whole or not at all*/
+void proto_send(uint8_t op, const uint8_t *payload, uint8_t len)
+{
+	uint8_t frame[PROTO_MAX_PAYLOAD+4];
+	uint8_t i;
+
+	frame[0]=PROTO_SYNC;
+	frame[1]=op;
+	frame[2]=len;
+	for(i=0;i<len;i++)
+	frame[3+i]=payload[i];
+	frame[3+len]=proto_crc8(0,&frame[1],len+2);
+	uart_write((const char *)frame,len+4);
+}
+
+void proto_nack(uint8_t op, uint8_t err)
+{
+	uint8_t reply[2]={op,err};
+	proto_send(PROTO_NACK,reply,2);
+}
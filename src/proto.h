@@ -0,0 +1,67 @@
+/*
+ * proto.h
+ * compact binary framing for test rigs, runs next to the MIN:/MAX: text commands
+ *
+ * frame:  SYNC(0xA5) | OP | LEN | PAYLOAD[LEN] | CRC-8
+ * the CRC-8 (polynomial 0x07, start 0x00) covers OP, LEN and the payload.
+ * every request frame is answered with one frame:
+ *   ACK   op|0x80, payload = result of the operation (may be empty)
+ *   NACK  PROTO_NACK, payload = { request op, PROTO_ERR_* }
+ */
+
+
+#ifndef PROTO_H_
+#define PROTO_H_
+
+#include <stdint.h>
+
+#define PROTO_SYNC			0xA5
+#define PROTO_MAX_PAYLOAD	32
+
+/* request opcodes */
+#define PROTO_OP_PING		0x01	/* -> ack, empty */
+#define PROTO_OP_SET_MIN	0x10	/* u8 -> ack, staged until the button is pressed */
+#define PROTO_OP_SET_MAX	0x11	/* u8 -> ack, staged until the button is pressed */
+#define PROTO_OP_SET_FILTER	0x12	/* mode, k, median -> ack, applied at once (adc_filter.h) */
+#define PROTO_OP_SET_SCAN	0x13	/* 1-8 channels -> ack, the first drives the PWM (adc.h) */
+#define PROTO_OP_SET_CURVE	0x14	/* type, gamma * 10 (10..50) -> ack, staged until the button is pressed */
+#define PROTO_OP_SET_POINTS	0x15	/* first index, u16 points... -> ack, custom curve, staged */
+#define PROTO_OP_CAPTURE	0x16	/* trigger, level u16, decimation, pre u16 -> ack, capture.h dump when full */
+#define PROTO_OP_SET_PID	0x17	/* on, sp channel, sp u16, kp ki kd u16 Q8.8, div -> ack, applied at once (pid.h) */
+#define PROTO_OP_GET_PWM	0x20	/* -> u16 pwm_value, little endian */
+#define PROTO_OP_GET_CONFIG	0x21	/* -> min, max, staged min, staged max, staged flag */
+#define PROTO_OP_GET_FILTER	0x22	/* -> mode, k, median */
+#define PROTO_OP_GET_ADC	0x23	/* -> u16 raw result per scan entry, little endian */
+#define PROTO_OP_GET_CURVE	0x24	/* -> type, gamma * 10, staged type, staged gamma * 10 */
+#define PROTO_OP_GET_PID	0x25	/* -> same layout as SET_PID */
+#define PROTO_OP_BATCH		0x30	/* { op, len, payload }... -> { reply op, len, payload }... */
+#define PROTO_OP_TEXT		0x7E	/* -> ack, then back to text commands */
+
+#define PROTO_ACK			0x80	/* or'ed into the request op */
+#define PROTO_NACK			0xFF
+
+/* NACK reasons */
+#define PROTO_ERR_CRC		0x01
+#define PROTO_ERR_OP		0x02	/* unknown opcode */
+#define PROTO_ERR_LEN		0x03	/* wrong payload length */
+#define PROTO_ERR_RANGE		0x04
+#define PROTO_ERR_CONFLICT	0x05	/* MIN >= MAX */
+
+/* proto_feed() results */
+#define PROTO_MORE			0		/* frame not complete yet */
+#define PROTO_FRAME			1		/* valid frame in *frame */
+#define PROTO_BAD_CRC		2		/* complete frame with a wrong CRC, frame->op is unreliable */
+
+typedef struct {
+	uint8_t op;
+	uint8_t len;
+	uint8_t payload[PROTO_MAX_PAYLOAD];
+} proto_frame_t;
+
+uint8_t proto_crc8(uint8_t crc, const uint8_t *data, uint8_t len);
+uint8_t proto_feed(proto_frame_t *frame, uint8_t byte);	/* feed received bytes one at a time */
+void proto_reset(void);				/* drop a half received frame */
+void proto_send(uint8_t op, const uint8_t *payload, uint8_t len);
+void proto_nack(uint8_t op, uint8_t err);
+
+#endif /* PROTO_H_ */
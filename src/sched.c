@@ -0,0 +1,138 @@
+/*
+ * sched.c
+ * deadlines are compared as signed 16-bit differences so the ms counter may wrap
+ */
+#include "hal.h"
+#include "prof.h"
+#include "sched.h"
+
+static const sched_task_t *sched_tasks;
+static uint8_t sched_count;
+static uint16_t sched_period_ms[SCHED_MAX_TASKS];
+static uint16_t sched_due[SCHED_MAX_TASKS];		/* next periodic run */
+static uint16_t sched_timer[SCHED_MAX_TASKS];		/* one-shot deadline */
+static uint8_t sched_armed[SCHED_MAX_TASKS];		/* sched_timer[] is set */
+static volatile uint16_t sched_ms;
+static uint32_t sched_slept;		/* Timer5 ticks in idle sleep */
+
+void sched_init(const sched_task_t *tasks, uint8_t n)
+{
+	uint8_t i;
+
+	hal_prof_init();		/* times the sleep, also with PROF_ENABLE=0 */
+	sched_tasks=tasks;
+	sched_count=n<SCHED_MAX_TASKS?n:SCHED_MAX_TASKS;
+	for(i=0;i<sched_count;i++)
+	{
+		sched_period_ms[i]=tasks[i].period<SCHED_MAX_MS?tasks[i].period:SCHED_MAX_MS;
+		sched_due[i]=sched_ms+sched_period_ms[i];
+		sched_armed[i]=0;
+	}
+}
+
+uint32_t sched_sleep_ticks(void)
+{
+	return sched_slept;
+}
+
+void sched_tick(void)
+{
+	sched_ms++;
+}
+
+uint16_t sched_now(void)
+{
+	uint16_t ms;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ms=sched_ms;
+	}
+	return ms;
+}
+
+void sched_period(uint8_t task, uint16_t ms)
+{
+	if(ms>SCHED_MAX_MS) ms=SCHED_MAX_MS;
+	sched_period_ms[task]=ms;
+	sched_due[task]=sched_now()+ms;
+}
+
+void sched_after(uint8_t task, uint16_t ms)
+{
+	if(ms>SCHED_MAX_MS) ms=SCHED_MAX_MS;
+	sched_timer[task]=sched_now()+ms;
+	sched_armed[task]=1;
+}
+
+/** 1 when the task is due, moves its deadline on. LATE records how far behind it was*/
+static uint8_t sched_due_now(uint8_t i, uint16_t now)
+{
+	int16_t late;
+
+	if(sched_armed[i] && (late=now-sched_timer[i])>=0){
+		sched_armed[i]=0;
+	}else if(sched_period_ms[i] && (late=now-sched_due[i])>=0){
+		/* keep the rate, unless a whole period was lost */
+		sched_due[i]=(uint16_t)late<sched_period_ms[i]?sched_due[i]+sched_period_ms[i]:now+sched_period_ms[i];
+	}else return 0;
+#if PROF_ENABLE
+	prof_record(PROF_LATE,(uint16_t)late<0xFFFF/(1000/PROF_TICK_US)?(uint16_t)late*(1000/PROF_TICK_US):0xFFFF);
+#endif
+	return 1;
+}
+
+/** one pass over the table, returns how many tasks ran*/
+static uint8_t sched_pass(void)
+{
+	const sched_task_t *t;
+	uint16_t now=sched_now();
+	uint8_t i, ran=0;
+
+	for(i=0;i<sched_count;i++)
+	{
+		t=&sched_tasks[i];
+		if(sched_due_now(i,now) || (t->ready && t->ready())){
+			PROF_START(t_run);
+			t->run();
+			PROF_STOP(t->probe,t_run);
+			ran++;
+		}
+	}
+	return ran;
+}
+
+/** 1 when a task would run on the next pass, deadlines left alone*/
+static uint8_t sched_runnable(void)
+{
+	uint16_t now=sched_ms;		/* interrupts are off */
+	uint8_t i;
+
+	for(i=0;i<sched_count;i++)
+	{
+		if(sched_armed[i] && (int16_t)(now-sched_timer[i])>=0) return 1;
+		if(sched_period_ms[i] && (int16_t)(now-sched_due[i])>=0) return 1;
+		if(sched_tasks[i].ready && sched_tasks[i].ready()) return 1;
+	}
+	return 0;
+}
+
+void sched_run(void)
+{
+	for(;;)
+	{
+		if(sched_pass()) continue;
+		/* checked with interrupts off, so an event raised in between still wakes us */
+		cli();
+		if(sched_runnable()){
+			sei();
+			continue;
+		}
+		uint16_t t_sleep=hal_prof_now();
+		hal_sleep_idle();
+		t_sleep=hal_prof_now()-t_sleep;
+		sched_slept+=t_sleep;
+#if PROF_ENABLE
+		prof_record(PROF_SLEEP,t_sleep);
+#endif
+	}
+}
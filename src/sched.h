@@ -0,0 +1,39 @@
+/*
+ * sched.h
+ * cooperative scheduler on the 1 ms system tick. a task runs when its period is up,
+ * when its one-shot timer expires or when its ready() source reports work. tasks run
+ * to completion in table order, and when none is runnable the CPU sleeps in idle mode
+ * until the next interrupt (the tick at the latest).
+ *
+ *   periodic    period in ms, the next deadline is kept in step with the first one
+ *   event       ready() polled every pass, e.g. a UART line or a button event waiting
+ *   timer       sched_after(): once, ms from now, on any task
+ * deadlines are 16-bit ms compared as signed differences, so periods and timers are
+ * limited to SCHED_MAX_MS, longer ones are cut to it.
+ */
+
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS		8
+#define SCHED_MAX_MS		32000	/* below half the 16-bit ms wrap */
+
+typedef struct {
+	void (*run)(void);
+	uint8_t (*ready)(void);		/* event source, 0 = none */
+	uint16_t period;			/* ms, 0 = not periodic */
+	uint8_t probe;				/* prof.h probe timing each run */
+} sched_task_t;
+
+void sched_init(const sched_task_t *tasks, uint8_t n);	/* the table must stay valid */
+void sched_tick(void);			/* from the 1 ms tick interrupt */
+uint16_t sched_now(void);		/* ms since start, wraps after 65 s */
+void sched_period(uint8_t task, uint16_t ms);	/* change or (0) stop the period, from now on */
+void sched_after(uint8_t task, uint16_t ms);	/* run once ms from now, 0 = next pass */
+uint32_t sched_sleep_ticks(void);	/* time in idle sleep, Timer5 ticks (4 us), wraps */
+void sched_run(void);			/* never returns */
+
+#endif /* SCHED_H_ */
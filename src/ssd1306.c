@@ -15,103 +15,223 @@
 #include <math.h>
 #include <string.h>
 #include "I2C.h"
-#define F_CPU 16000000UL
-#include <util/delay.h>
-#include <avr/pgmspace.h>
+#include "hal.h"
 #include "ssd1306.h"
 #include "data.h"
 #define ssd1306_swap(a, b) { int16_t t = a; a = b; b = t; }
-#define _vccstate 1  //externalVcc
+#define _vccstate SSD1306_SWITCHCAPVCC  //internal charge pump, as set up by the init sequence
 
 uint8_t _i2c_address=0x78;    //display write address
 
+#ifdef SSD1306_FRAMEBUFFER
+//two frames with the page layout of the display RAM p. 25, swapped by ssd1306_flush()
+static uint8_t ssd1306_frames[2][SSD1306_BUFSIZE];
+uint8_t *ssd1306_buffer=ssd1306_frames[0];				//back: the frame being drawn
+static uint8_t *ssd1306_front=ssd1306_frames[1];		//front: the frame on (or going to) the display
+static volatile uint8_t ssd1306_front_state=I2C_DONE;	//I2C_DONE|status once the front is sent
+#endif
+
+//==========================================================//
+// Everything below goes through the interrupt driven I2C queue. The last descriptor of the
+// open transaction is kept here until we know if more bytes follow (I2C_MORE) or not.
+static i2c_xfer_t ssd1306_xfer;
+static uint8_t ssd1306_xfer_open;
+
+/** queue the held descriptor with I2C_MORE and start a new one*/
+static i2c_xfer_t *ssd1306_next(uint8_t flags)
+{
+	if(ssd1306_xfer_open)
+	{
+		ssd1306_xfer.flags|=I2C_MORE;
+		I2C_Queue(&ssd1306_xfer);
+	}
+	ssd1306_xfer.addr=_i2c_address;
+	ssd1306_xfer.flags=flags;
+	ssd1306_xfer.len=0;
+	ssd1306_xfer.done=0;
+	ssd1306_xfer.callback=0;
+	ssd1306_xfer_open=1;
+	return &ssd1306_xfer;
+}
+
+/** append one byte, copied so the caller's storage can go away*/
+static void ssd1306_put(uint8_t c)
+{
+	if(!(ssd1306_xfer.flags&I2C_INLINE) || ssd1306_xfer.len==I2C_INLINE_MAX)
+	ssd1306_next(I2C_INLINE);
+	ssd1306_xfer.src.bytes[ssd1306_xfer.len++]=c;
+}
+
+/** queue the held descriptor as the end of the transaction*/
+static void ssd1306_close(void)
+{
+	I2C_Queue(&ssd1306_xfer);
+	ssd1306_xfer_open=0;
+}
+
+/**write a list of commands to the ssd1306 in one transaction.
+* With Co=0 in the control byte every following byte is a command p. 20*/
+void  ssd1306_commands(const uint8_t *c, uint8_t n)
+{
+	uint8_t control = 0x00; // some use 0X00 other examples use 0X80. I tried both
+	ssd1306_next(I2C_INLINE);
+	ssd1306_put(control); // This is Command
+	while(n--)
+	ssd1306_put(*c++);
+	ssd1306_close();
+}
+/** same as ssd1306_commands() with the list in flash, sent straight from there*/
+void ssd1306_commands_P(const uint8_t *c, uint8_t n)
+{
+	i2c_xfer_t *x;
+	ssd1306_next(I2C_INLINE);
+	ssd1306_put(0x00); // This is Command
+	x=ssd1306_next(I2C_PGM);
+	x->src.ptr=c;
+	x->len=n;
+	ssd1306_close();
+}
+////////////////////////////////////////////
 /**write a command to the ssd1306*/
 void  ssd1306_command(uint8_t c)
 {
-	uint8_t control = 0x00; // some use 0X00 other examples use 0X80. I tried both
-	I2C_Start(_i2c_address);
-	//I2C_Write();
-	I2C_Write(control); // This is Command
-	I2C_Write(c);
-	I2C_Stop();
+	ssd1306_commands(&c,1);
+}
+////////////////////////////////////////////
+/** Open a data transaction, every ssd1306_data_write() until ssd1306_data_end()
+* goes to the display RAM without a new start/address/control byte.*/
+void ssd1306_data_begin(void)
+{
+	ssd1306_next(I2C_INLINE);
+	ssd1306_put(0X40); // This byte is DATA
+}
+/** write one display RAM byte inside ssd1306_data_begin()/ssd1306_data_end()*/
+void ssd1306_data_write(uint8_t c)
+{
+	ssd1306_put(c);
+}
+/** write n display RAM bytes from flash inside ssd1306_data_begin()/ssd1306_data_end()*/
+void ssd1306_data_write_P(const uint8_t *p, uint16_t n)
+{
+	i2c_xfer_t *x=ssd1306_next(I2C_PGM);
+	x->src.ptr=p;
+	x->len=n;
+}
+/** write n display RAM bytes from RAM without copying them,
+* the buffer must not change until I2C_Wait() returns*/
+void ssd1306_data_write_buf(const uint8_t *p, uint16_t n)
+{
+	i2c_xfer_t *x=ssd1306_next(0);
+	x->src.ptr=p;
+	x->len=n;
+}
+/** write the same display RAM byte n times*/
+void ssd1306_data_fill(uint8_t c, uint16_t n)
+{
+	i2c_xfer_t *x=ssd1306_next(I2C_FILL);
+	x->src.bytes[0]=c;
+	x->len=n;
+}
+/** close the data transaction*/
+void ssd1306_data_end(void)
+{
+	ssd1306_close();
+}
+/** close the data transaction, *done becomes I2C_DONE|status once it has left the bus*/
+void ssd1306_data_end_done(volatile uint8_t *done)
+{
+	*done=0;
+	ssd1306_xfer.done=done;
+	ssd1306_close();
 }
 ////////////////////////////////////////////
 //
 /**write a a data byte to the ssd1306*/
 void  ssd1306_data(uint8_t c)
 {
-	I2C_Start(_i2c_address);
-	I2C_Write(_i2c_address);
-	I2C_Write(0X40); // This byte is DATA
-	I2C_Write(c);
-	I2C_Stop();
+	ssd1306_data_begin();
+	ssd1306_data_write(c);
+	ssd1306_data_end();
 }
 ///////////////////////////////////////////////////
 /** Used when doing Horizontal or Vertical Addressing*/
 void setColAddress()
 {
-	ssd1306_command(SSD1306_COLUMNADDR); // 0x21 COMMAND
-	ssd1306_command(0); // Column start address
-	ssd1306_command(SSD1306_LCDWIDTH-1); // Column end address
+	uint8_t cmd[]={SSD1306_COLUMNADDR,	// 0x21 COMMAND
+		0,								// Column start address
+		SSD1306_LCDWIDTH-1};			// Column end address
+	ssd1306_commands(cmd,sizeof(cmd));
 }
 /////////////////////////////////////////////////////
 /** Used when doing Horizontal or Vertical Addressing*/
 void setPageAddress()
 {
-	ssd1306_command(SSD1306_PAGEADDR); // 0x22 COMMAND
-	ssd1306_command(0); // Start Page address
-	ssd1306_command((SSD1306_LCDHEIGHT/8)-1);// End Page address
+	uint8_t cmd[]={SSD1306_PAGEADDR,	// 0x22 COMMAND
+		0,								// Start Page address
+		(SSD1306_LCDHEIGHT/8)-1};		// End Page address
+	ssd1306_commands(cmd,sizeof(cmd));
+}
+///////////////////////////////////////////////////
+/** Limit the address pointer to w columns from x and pages from page, one command
+* transaction. In horizontal addressing mode (set by InitializeDisplay()) data then fills
+* the rectangle row by row and wraps inside it p. 34-36*/
+void ssd1306_window(uint8_t x, uint8_t page, uint8_t w, uint8_t pages)
+{
+	uint8_t cmd[]={SSD1306_COLUMNADDR,x,x+w-1,
+		SSD1306_PAGEADDR,page,page+pages-1};
+	ssd1306_commands(cmd,sizeof(cmd));
+}
+/** Copy a w x pages rectangle from RAM, bytes in the page layout of the display RAM
+* (w bytes for the first page, then the next). One window command and one data
+* transaction for the whole rectangle. src must not change until I2C_Wait() returns*/
+void ssd1306_blit(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, const uint8_t *src)
+{
+	ssd1306_window(x,page,w,pages);
+	ssd1306_data_begin();
+	ssd1306_data_write_buf(src,(uint16_t)w*pages);
+	ssd1306_data_end();
+}
+/** Same as ssd1306_blit() with the rectangle in flash*/
+void ssd1306_blit_P(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, const uint8_t *src)
+{
+	ssd1306_window(x,page,w,pages);
+	ssd1306_data_begin();
+	ssd1306_data_write_P(src,(uint16_t)w*pages);
+	ssd1306_data_end();
+}
+/** Fill a w x pages rectangle with the same byte*/
+void ssd1306_fill(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, uint8_t c)
+{
+	ssd1306_window(x,page,w,pages);
+	ssd1306_data_begin();
+	ssd1306_data_fill(c,(uint16_t)w*pages);
+	ssd1306_data_end();
 }
 ///////////////////////////////////////////////////////////////////
 /** init according to SSD1306 data sheet and using the plus can be connected to PIN 24 and the GND to PIN 26 */
+// Init sequence for 128x64 OLED module, sent as one command stream
+static const uint8_t ssd1306_init_seq[] PROGMEM = {
+	SSD1306_DISPLAYOFF,                     // 0xAE
+	SSD1306_SETDISPLAYCLOCKDIV, 0x80,       // 0xD5, the suggested ratio 0x80
+	SSD1306_SETMULTIPLEX, 0x3F,             // 0xA8
+	SSD1306_SETDISPLAYOFFSET, 0x0,          // 0xD3, no offset
+	SSD1306_SETSTARTLINE | 0x0,             // line #0
+	SSD1306_CHARGEPUMP, 0x14,               // 0x8D, using internal VCC
+	SSD1306_MEMORYMODE, 0x00,               // 0x20, 0x00 horizontal addressing automatic line shift
+	SSD1306_SEGREMAP | 0x1,                 // rotate screen 180
+	SSD1306_COMSCANDEC,                     // rotate screen 180
+	SSD1306_SETCOMPINS, 0x12,               // 0xDA
+	SSD1306_SETCONTRAST, 0xCF,              // 0x81
+	SSD1306_SETPRECHARGE, 0xF1,             // 0xd9
+	SSD1306_SETVCOMDETECT, 0x40,            // 0xDB
+	SSD1306_DISPLAYALLON_RESUME,            // 0xA4
+	SSD1306_NORMALDISPLAY,                  // 0xA6
+	SSD1306_DISPLAYON                       //switch on OLED
+};
 
 void  InitializeDisplay()
 {
-	
-
-
-	// Init sequence for 128x64 OLED module
-	ssd1306_command(SSD1306_DISPLAYOFF);                    // 0xAE
-
-	ssd1306_command(SSD1306_SETDISPLAYCLOCKDIV);            // 0xD5
-	ssd1306_command(0x80);                 // the suggested ratio 0x80
-
-	ssd1306_command(SSD1306_SETMULTIPLEX);                  // 0xA8
-	ssd1306_command(0x3F);
-
-	ssd1306_command(SSD1306_SETDISPLAYOFFSET);              // 0xD3
-	ssd1306_command(0x0);                                   // no offset
-
-	ssd1306_command(SSD1306_SETSTARTLINE);// | 0x0);        // line #0
-
-	ssd1306_command(SSD1306_CHARGEPUMP);                    // 0x8D
-	ssd1306_command(0x14);  // using internal VCC
-
-	ssd1306_command(SSD1306_MEMORYMODE);                    // 0x20
-	ssd1306_command(0x00);                         // 0x00 horizontal addressing automatic line shift
-
-	ssd1306_command(SSD1306_SEGREMAP | 0x1); // rotate screen 180
-
-	ssd1306_command(SSD1306_COMSCANDEC); // rotate screen 180
-
-	ssd1306_command(SSD1306_SETCOMPINS);                    // 0xDA
-	ssd1306_command(0x12);
-
-	ssd1306_command(SSD1306_SETCONTRAST);                   // 0x81
-	ssd1306_command(0xCF);
-
-	ssd1306_command(SSD1306_SETPRECHARGE);                  // 0xd9
-	ssd1306_command(0xF1);
-
-	ssd1306_command(SSD1306_SETVCOMDETECT);                 // 0xDB
-	ssd1306_command(0x40);
-
-	ssd1306_command(SSD1306_DISPLAYALLON_RESUME);           // 0xA4
-
-	ssd1306_command(SSD1306_NORMALDISPLAY);                 // 0xA6
-
-	ssd1306_command(SSD1306_DISPLAYON);                     //switch on OLED
-
+	ssd1306_commands_P(ssd1306_init_seq,sizeof(ssd1306_init_seq));
 }
 
 /** reset the display*/
@@ -143,21 +263,21 @@ void displayOff(void)
 }
 
 //==========================================================//
-/** Clears the display by sending 0 to all the screen map.*/
+/** Clears the display by sending 0 to all the screen map in one transaction.*/
 void clear_display(void)
 {
-	unsigned char i,k;
-	for(k=0;k<8;k++)
-	{
-		setXY(k,0);
-		{
-			for(i=0;i<128;i++)     //clear all COL
-			{
-				SendChar(0);         //clear all COL
-				//delay(10);
-			}
-		}
-	}
+#ifdef SSD1306_FRAMEBUFFER
+	I2C_Wait();	//a flush may still be sending from the front
+	memset(ssd1306_frames,0,sizeof(ssd1306_frames));	//both frames match the blank display
+#endif
+	ssd1306_fill(0,0,SSD1306_LCDWIDTH,SSD1306_LCDHEIGHT/8,0);
+}
+
+//==========================================================//
+/** Full screen splash from data.h*/
+void ssd1306_splash(void)
+{
+	ssd1306_blit_P(0,0,SSD1306_LCDWIDTH,SSD1306_LCDHEIGHT/8,(const uint8_t *)splash);
 }
 
 
@@ -199,23 +319,10 @@ void printBigTime(char *string)
 * and 8 ROWS (0-7).*/
 void printBigNumber(char string, int X, int Y)
 {
-	setXY(X,Y);               //set the cursor to start
-	int salto=0;
-	for(int i=0;i<96;i++)
-	{
-		if(string == ' ') {
-			SendChar(0);
-		} else
-		SendChar(pgm_read_byte(bigNumbers[string-0x30]+i));
-
-		if(salto == 23) {
-			salto = 0;
-			X++;
-			setXY(X,Y);
-			} else {
-			salto++;
-		}
-	}
+	if(string == ' ')	//4 pages of 24 columns in one window
+	ssd1306_fill(Y*8,X,24,4,0);
+	else
+	ssd1306_blit_P(Y*8,X,24,4,(const uint8_t *)bigNumbers[string-0x30]);
 }
 
 //==========================================================//
@@ -224,10 +331,7 @@ void printBigNumber(char string, int X, int Y)
 * for the big number font.*/
 void SendChar(unsigned char data)
 {
-	I2C_Start(_i2c_address); // begin transmitting
-	I2C_Write(0x40);//data mode
-	I2C_Write(data);
-	I2C_Stop();    // stop transmitting
+	ssd1306_data(data);
 }
 
 //==========================================================//
@@ -237,22 +341,18 @@ void SendChar(unsigned char data)
 void sendCharXY(unsigned char data, int X, int Y)
 {
 	setXY(X, Y);
-	I2C_Start(_i2c_address); // begin transmitting
-	I2C_Write(0x40);//data mode
-
-	for(int i=0;i<8;i++)
-	I2C_Write(pgm_read_byte(myFont[data-0x20]+i));
-
-	I2C_Stop();    // stop transmitting
+	ssd1306_data_begin();
+	ssd1306_data_write_P((const uint8_t *)myFont[data-0x20],8);
+	ssd1306_data_end();
 }
 
 //==========================================================//
-/** Set the cursor position in a 16 COL * 8 ROW map.*/
+/** Set the cursor position in a 16 COL * 8 ROW map.
+* The window reaches to the bottom right corner, text running past COL 15
+* continues on the next ROW at col.*/
 void setXY(unsigned char row,unsigned char col)
 {
-	ssd1306_command(0xb0+row);                //set page address    p. 31
-	ssd1306_command(0x00+(8*col&0x0f));       //set low col address   p. 30
-	ssd1306_command(0x10+((8*col>>4)&0x0f));  //set high col address   p.30
+	ssd1306_window(8*col,row,SSD1306_LCDWIDTH-8*col,SSD1306_LCDHEIGHT/8-row);
 }
 
 
@@ -260,15 +360,13 @@ void setXY(unsigned char row,unsigned char col)
 /** Prints a string regardless the cursor position.*/
 void sendStr(char *string)
 {
-	unsigned char i=0;
+	ssd1306_data_begin();
 	while(*string)
 	{
-		for(i=0;i<8;i++)
-		{
-			SendChar(pgm_read_byte(myFont[*string-0x20]+i));   //look up ascii chars (no danish) defined in data.h
-		}
+		ssd1306_data_write_P((const uint8_t *)myFont[*string-0x20],8);   //look up ascii chars (no danish) defined in data.h
 		string++;
 	}
+	ssd1306_data_end();
 }
 
 //==========================================================//
@@ -277,92 +375,160 @@ void sendStr(char *string)
 void sendStrXY( char *string, int X, int Y)
 {
 	setXY(X,Y);
-	unsigned char i=0;
+	ssd1306_data_begin();
 	while(*string)
 	{    if (*string=='\n'){
-		setXY(X+1,0);
+		ssd1306_data_end();   //the cursor can only move between transactions
+		setXY(++X,0);
+		ssd1306_data_begin();
 		string++;
+		continue;
 		}
-		for(i=0;i<8;i++)
-		{
-			SendChar(pgm_read_byte(myFont[*string-0x20]+i));
-		}
+		ssd1306_data_write_P((const uint8_t *)myFont[*string-0x20],8);
 		string++;
 	}
+	ssd1306_data_end();
 }
+/** Set the cursor to column x of page y, the window reaches to the bottom right corner*/
 void ssd1306_setpos(uint8_t x, uint8_t y)
 {
-
-	ssd1306_command(0xb0 + y);
-	ssd1306_command(((x & 0xf0) >> 4) | 0x10); // | 0x10
-
-
+	ssd1306_window(x,y,SSD1306_LCDWIDTH-x,SSD1306_LCDHEIGHT/8-y);
 }
 void print_fonts(){
 	clear_display();
 
-	uint8_t data=32;
-	for(int k=0;k<6;k++){
-		setXY(k,0);
-
-		for (int j=0;j<16;j++)
-		{
-
-			for(int i=0;i<8;i++){
-			SendChar(pgm_read_byte(myFont[(data+j)-0x20]+i));
-			}
-		}
-		data=data+16;
-	}
+	//the 96 glyphs lie back to back in flash, 16 to a page
+	ssd1306_blit_P(0,0,SSD1306_LCDWIDTH,6,(const uint8_t *)myFont);
 	}
+/** Draw a bitmap from flash into columns x0..x1-1 of pages y0..y1-1*/
 void ssd1306_draw_bmp(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, const uint8_t bitmap[])
 {
-	uint16_t j = 0;
-	uint8_t y;
-	if (y1 % 8 == 0) y = y1 / 8;
-	else y = y1 / 8 + 1;
-	for (y = y0; y < y1; y++)
+	ssd1306_blit_P(x0,y0,x1-x0,y1-y0,bitmap);
+}
+#ifdef SSD1306_FRAMEBUFFER
+/** set, clear or invert one pixel in the framebuffer, shown on the next ssd1306_flush()*/
+void drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+	if ((x < 0) || (x >= SSD1306_LCDWIDTH) || (y < 0) || (y >= SSD1306_LCDHEIGHT))
+	return;
+
+	// x is which column
+	switch (color)
 	{
-		ssd1306_setpos(x0,y);
+		case WHITE:   ssd1306_buffer[x+ (y/8)*SSD1306_LCDWIDTH] |=  (1 << (y&7)); break;
+		case BLACK:   ssd1306_buffer[x+ (y/8)*SSD1306_LCDWIDTH] &= ~(1 << (y&7)); break;
+		case INVERSE: ssd1306_buffer[x+ (y/8)*SSD1306_LCDWIDTH] ^=  (1 << (y&7)); break;
+	}
+}
 
-		for (uint8_t x = x0; x < x1; x++)
-		{
-			 ssd1306_data(pgm_read_byte(&bitmap[j++]));
-		}
+//==========================================================//
+/** Blank the framebuffer, the display keeps its content until ssd1306_flush()*/
+void ssd1306_fb_clear(void)
+{
+	memset(ssd1306_buffer,0,SSD1306_BUFSIZE);
+}
 
+//==========================================================//
+/** Same as sendCharXY() but draws into the framebuffer.
+* X is the ROW (page 0-7) and Y the COL (0-15) like the rest of the text functions.*/
+void ssd1306_fb_char(unsigned char data, int X, int Y)
+{
+	uint8_t *dst=&ssd1306_buffer[X*SSD1306_LCDWIDTH+Y*8];
+	for(uint8_t i=0;i<8;i++)
+	dst[i]=pgm_read_byte(myFont[data-0x20]+i);
+}
+
+//==========================================================//
+/** Same as sendStrXY() but draws into the framebuffer.
+* Text running past COL 15 continues on the next ROW at the first COL like it
+* does in the window setXY() opens.*/
+void ssd1306_fb_str(char *string, int X, int Y)
+{
+	int Y0=Y;
+	while(*string && X<SSD1306_LCDHEIGHT/8)
+	{
+		if (*string=='\n'){
+			X++;
+			Y=0;
+			string++;
+			continue;
+		}
+		ssd1306_fb_char(*string,X,Y);
+		if(++Y==SSD1306_LCDWIDTH/8){
+			Y=Y0;
+			X++;
+		}
+		string++;
 	}
 }
-/*
-void drawPixel(int16_t x, int16_t y, uint16_t color) {
-	if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
-	return;
 
-	// check rotation, move pixel around if necessary
-	switch (getRotation()) {
-		case 1:
-		ssd1306_swap(x, y);
-		x = WIDTH - x - 1;
-		break;
-		case 2:
-		x = WIDTH - x - 1;
-		y = HEIGHT - y - 1;
-		break;
-		case 3:
-		ssd1306_swap(x, y);
-		y = HEIGHT - y - 1;
-		break;
+//==========================================================//
+/** Send the parts of the back frame that differ from the front (what the display holds).
+* Each page is scanned for runs of changed columns, runs closer than
+* SSD1306_FLUSH_GAP columns are merged, and every run goes out as one
+* position command plus a single data transaction. An unchanged frame costs no bus time.
+* The back frame then becomes the front with one pointer swap and is streamed by the
+* I2C interrupt while the caller draws the next frame into the new back. The changed runs
+* are copied into the new back so it starts from what is on the display.
+* Returns 0 without doing anything while the previous frame is still on the bus, the
+* caller just draws again and retries instead of waiting.*/
+uint8_t ssd1306_flush(void)
+{
+	uint8_t page,first,last,col,open=0;
+	uint8_t *back=ssd1306_buffer,*front=ssd1306_front,*tmp;
+
+	if(!(ssd1306_front_state&I2C_DONE)) return 0;
+	if(ssd1306_front_state!=(I2C_DONE|I2C_OK))	//the last frame did not make it, resend all of it
+	for(uint16_t i=0;i<SSD1306_BUFSIZE;i++) front[i]=~back[i];
+
+	for(page=0;page<SSD1306_LCDHEIGHT/8;page++)
+	{
+		col=0;
+		while(col<SSD1306_LCDWIDTH)
+		{
+			while(col<SSD1306_LCDWIDTH && back[col]==front[col]) col++;	//skip unchanged columns
+			if(col==SSD1306_LCDWIDTH) break;
+			first=col;
+			last=col;
+			//extend the run until SSD1306_FLUSH_GAP columns in a row are unchanged
+			while(++col<SSD1306_LCDWIDTH && col-last<=SSD1306_FLUSH_GAP)
+			{
+				if(back[col]!=front[col]) last=col;
+			}
+			col=last+1;
+
+			if(open) ssd1306_data_end();
+			memcpy(&front[first],&back[first],last-first+1);
+			ssd1306_window(first,page,last-first+1,1);
+			ssd1306_data_begin();
+			ssd1306_data_write_buf(&back[first],last-first+1);
+			open=1;
+		}
+		back+=SSD1306_LCDWIDTH;
+		front+=SSD1306_LCDWIDTH;
 	}
+	if(open)	//the last run tells us when the whole frame is on the display
+	ssd1306_data_end_done(&ssd1306_front_state);
 
-	// x is which column
-	switch (color)
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		case WHITE:   buffer[x+ (y/8)*SSD1306_LCDWIDTH] |=  (1 << (y&7)); break;
-		case BLACK:   buffer[x+ (y/8)*SSD1306_LCDWIDTH] &= ~(1 << (y&7)); break;
-		case INVERSE: buffer[x+ (y/8)*SSD1306_LCDWIDTH] ^=  (1 << (y&7)); break;
+		tmp=ssd1306_buffer;
+		ssd1306_buffer=ssd1306_front;
+		ssd1306_front=tmp;
 	}
+	return 1;
+}
 
+//==========================================================//
+/** Forget what the display holds so the next ssd1306_flush() resends the whole frame,
+* use after the display RAM was written behind the framebuffers back.*/
+void ssd1306_invalidate(void)
+{
+	I2C_Wait();
+	for(uint16_t i=0;i<SSD1306_BUFSIZE;i++)
+	ssd1306_front[i]=~ssd1306_buffer[i];
 }
-*/
+#endif
 void invertDisplay(uint8_t i) {
 	if (i) {
 		ssd1306_command(SSD1306_INVERTDISPLAY);
@@ -375,60 +541,64 @@ void invertDisplay(uint8_t i) {
 * Hint, the display is 16 rows tall. To scroll the whole display, run:
 * scroll right(0x00, 0x0F)*/
 void startscrollright(uint8_t start, uint8_t stop){
-	ssd1306_command(SSD1306_RIGHT_HORIZONTAL_SCROLL);
-	ssd1306_command(0X00);
-	ssd1306_command(start);
-	ssd1306_command(0X00);
-	ssd1306_command(stop);
-	ssd1306_command(0X00);
-	ssd1306_command(0XFF);
-	ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+	uint8_t cmd[]={SSD1306_RIGHT_HORIZONTAL_SCROLL,
+		0X00,
+		start,
+		0X00,
+		stop,
+		0X00,
+		0XFF,
+		SSD1306_ACTIVATE_SCROLL};
+	ssd1306_commands(cmd,sizeof(cmd));
 }
 /** startscrollleft
 * Activate a right handed scroll for rows start through stop
 *Hint, the display is 16 rows tall. To scroll the whole display, run:
 * scrollleft(0x00, 0x0F) */
 void startscrollleft(uint8_t start, uint8_t stop){
-	ssd1306_command(SSD1306_LEFT_HORIZONTAL_SCROLL);
-	ssd1306_command(0X00);
-	ssd1306_command(start);
-	ssd1306_command(0X00);
-	ssd1306_command(stop);
-	ssd1306_command(0X00);
-	ssd1306_command(0XFF);
-	ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+	uint8_t cmd[]={SSD1306_LEFT_HORIZONTAL_SCROLL,
+		0X00,
+		start,
+		0X00,
+		stop,
+		0X00,
+		0XFF,
+		SSD1306_ACTIVATE_SCROLL};
+	ssd1306_commands(cmd,sizeof(cmd));
 }
 /** startscrolldiagright
 *Activate a diagonal scroll for rows start through stop
 * Hint, the display is 16 rows tall. To scroll the whole display, run:
 * display.scrollright(0x00, 0x0F)*/
 void startscrolldiagright(uint8_t start, uint8_t stop){
-	ssd1306_command(SSD1306_SET_VERTICAL_SCROLL_AREA);
-	ssd1306_command(0X00);
-	ssd1306_command(SSD1306_LCDHEIGHT);
-	ssd1306_command(SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL);
-	ssd1306_command(0X00);
-	ssd1306_command(start);
-	ssd1306_command(0X00);
-	ssd1306_command(stop);
-	ssd1306_command(0X01);
-	ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+	uint8_t cmd[]={SSD1306_SET_VERTICAL_SCROLL_AREA,
+		0X00,
+		SSD1306_LCDHEIGHT,
+		SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL,
+		0X00,
+		start,
+		0X00,
+		stop,
+		0X01,
+		SSD1306_ACTIVATE_SCROLL};
+	ssd1306_commands(cmd,sizeof(cmd));
 }
 /** startscrolldiagleft
 * Activate a diagonal scroll for rows start through stop
 *Hint, the display is 16 rows tall. To scroll the whole display, run:
 * display.scrollright(0x00, 0x0F)*/
 void startscrolldiagleft(uint8_t start, uint8_t stop){
-	ssd1306_command(SSD1306_SET_VERTICAL_SCROLL_AREA);
-	ssd1306_command(0X00);
-	ssd1306_command(SSD1306_LCDHEIGHT);
-	ssd1306_command(SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL);
-	ssd1306_command(0X00);
-	ssd1306_command(start);
-	ssd1306_command(0X00);
-	ssd1306_command(stop);
-	ssd1306_command(0X01);
-	ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+	uint8_t cmd[]={SSD1306_SET_VERTICAL_SCROLL_AREA,
+		0X00,
+		SSD1306_LCDHEIGHT,
+		SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL,
+		0X00,
+		start,
+		0X00,
+		stop,
+		0X01,
+		SSD1306_ACTIVATE_SCROLL};
+	ssd1306_commands(cmd,sizeof(cmd));
 }
 void stopscroll(void){
 	ssd1306_command(SSD1306_DEACTIVATE_SCROLL);
@@ -451,6 +621,7 @@ void dim(bool dim) {
 	}
 	// the range of contrast to too small to be really useful
 	// it is useful to dim the display
-	ssd1306_command(SSD1306_SETCONTRAST);
-	ssd1306_command(contrast);
+	uint8_t cmd[]={SSD1306_SETCONTRAST,
+		contrast};
+	ssd1306_commands(cmd,sizeof(cmd));
 }
\ No newline at end of file
@@ -34,6 +34,13 @@
 #define SSD1306_LCDHEIGHT                 16
 #endif
 
+//draw into a page organised back frame in SRAM, ssd1306_flush() sends what changed and swaps it
+//with the front frame being sent. Costs 2 x 1 KB on a 128x64 panel, comment out on parts with
+//2 KB of SRAM like the 328P
+#define SSD1306_FRAMEBUFFER
+//unchanged columns inside a page that are cheaper to resend than to start a new span for
+#define SSD1306_FLUSH_GAP                 8
+
 // #define pgm_read_byte(addr) (*(const unsigned char *)(addr))
 //command data defined p 28 - 32
 #define SSD1306_LCDWIDTH      128
@@ -76,9 +83,24 @@
 #define WHITE 1
 #define INVERSE 2
 
+#define SSD1306_BUFSIZE (SSD1306_LCDWIDTH*SSD1306_LCDHEIGHT/8)
+
 typedef uint8_t bitmap_t[8][128];
 uint8_t _i2c_address;
 void  InitializeDisplay();
+void ssd1306_command(uint8_t c);
+void ssd1306_commands(const uint8_t *c, uint8_t n);
+void ssd1306_commands_P(const uint8_t *c, uint8_t n);
+void ssd1306_data(uint8_t c);
+//burst data: one start/address/control byte for any number of display RAM bytes
+//all of it is queued for the I2C interrupt and sent in the background
+void ssd1306_data_begin(void);
+void ssd1306_data_write(uint8_t c);
+void ssd1306_data_write_P(const uint8_t *p, uint16_t n);
+void ssd1306_data_write_buf(const uint8_t *p, uint16_t n);
+void ssd1306_data_fill(uint8_t c, uint16_t n);
+void ssd1306_data_end(void);
+void ssd1306_data_end_done(volatile uint8_t *done);
 void sendStrXY( char *string, int X, int Y);
 void sendStr( char *string);
 void setXY(unsigned char row,unsigned char col);
@@ -95,6 +117,12 @@ void setPageAddress();
 void setColAddress();
 void ssd1306_setpos(uint8_t x, uint8_t y);
 void ssd1306_draw_bmp(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, const uint8_t bitmap[]);
+//rectangles of w columns and pages in horizontal addressing mode: one window, one data transaction
+void ssd1306_window(uint8_t x, uint8_t page, uint8_t w, uint8_t pages);
+void ssd1306_blit(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, const uint8_t *src);
+void ssd1306_blit_P(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, const uint8_t *src);
+void ssd1306_fill(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, uint8_t c);
+void ssd1306_splash(void);
 //scroll
 void startscrollright(uint8_t start, uint8_t stop);
 void startscrollleft(uint8_t start, uint8_t stop);
@@ -105,4 +133,12 @@ void stopscroll(void);
 void dim(bool dim);
 void print_fonts();
 void drawPixel(int16_t x, int16_t y, uint16_t color);
+#ifdef SSD1306_FRAMEBUFFER
+extern uint8_t *ssd1306_buffer;	//back frame, swapped by ssd1306_flush()
+void ssd1306_fb_clear(void);
+void ssd1306_fb_char(unsigned char data, int X, int Y);
+void ssd1306_fb_str(char *string, int X, int Y);
+uint8_t ssd1306_flush(void);
+void ssd1306_invalidate(void);
+#endif
 
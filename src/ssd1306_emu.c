@@ -0,0 +1,255 @@
+/*
+ * ssd1306_emu.c
+ * SSD1306 model for the native build, see ssd1306_emu.h
+ * command lengths and address pointer rules from the SSD1306 data sheet rev 1.1, p. 28-46
+ */
+#ifdef HAL_HOST
+
+#include "hal.h"
+#include "ssd1306_emu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODE_HORIZONTAL	0
+#define MODE_VERTICAL	1
+#define MODE_PAGE		2
+
+ssd1306_emu_stats_t ssd1306_emu_frame;
+ssd1306_emu_stats_t ssd1306_emu_total;
+uint32_t ssd1306_emu_frames;
+
+static uint8_t ram[8][128];
+static uint8_t mode=MODE_PAGE;
+static uint8_t col, page;
+static uint8_t col_start, col_end=127, page_start, page_end=7;
+static uint8_t seg_remap, com_dec, start_line, offset, invert, all_on, display_on;
+
+static uint8_t cmd[7];			/* command being collected, parameters may come in later transactions */
+static uint8_t cmd_len, cmd_need;
+
+static uint8_t in_xfer;			/* inside a transaction to the display */
+static uint8_t first;			/* next byte is the address */
+static uint8_t ctrl_next;		/* next byte is a control byte */
+static uint8_t single;			/* Co=1: one byte, then a control byte again */
+static uint8_t is_data;			/* D/C# of the current control byte */
+static uint64_t last_stop;
+
+static uint32_t scl_khz=400;
+static uint8_t stats;
+static const char *pbm;
+
+//================================================================================================================================
+//	decoding
+//================================================================================================================================
+
+/** parameter bytes that follow a command byte*/
+static uint8_t params(uint8_t c)
+{
+	switch(c)
+	{
+		case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+		case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+		return 1;
+		case 0x21: case 0x22: case 0xA3:
+		return 2;
+		case 0x29: case 0x2A:
+		return 5;
+		case 0x26: case 0x27:
+		return 6;
+		default:
+		return 0;
+	}
+}
+
+static void execute(void)
+{
+	uint8_t c=cmd[0];
+
+	if(c<0x10) col=(col&0xF0)|c;				/* page mode lower column */
+	else if(c<0x20) col=(col&0x0F)|((c&0x0F)<<4);
+	else if(c==0x20) mode=cmd[1]&3;
+	else if(c==0x21){
+		col_start=col=cmd[1]&127;
+		col_end=cmd[2]&127;
+	}else if(c==0x22){
+		page_start=page=cmd[1]&7;
+		page_end=cmd[2]&7;
+	}else if(c>=0x40 && c<0x80) start_line=c&63;
+	else if(c==0xA0 || c==0xA1) seg_remap=c&1;
+	else if(c==0xA4 || c==0xA5) all_on=c&1;
+	else if(c==0xA6 || c==0xA7) invert=c&1;
+	else if(c==0xAE || c==0xAF) display_on=c&1;
+	else if(c>=0xB0 && c<0xB8) page=c&7;
+	else if(c==0xC0 || c==0xC8) com_dec=c==0xC8;
+	else if(c==0xD3) offset=cmd[1]&63;
+}
+
+static void command(uint8_t b)
+{
+	if(!cmd_need){
+		cmd[0]=b;
+		cmd_len=1;
+		cmd_need=params(b);
+	}else{
+		cmd[cmd_len++]=b;
+		cmd_need--;
+	}
+	if(!cmd_need) execute();
+}
+
+/** one byte into GDDRAM and the pointer moved on per addressing mode*/
+static void data(uint8_t b)
+{
+	ram[page][col]=b;
+	ssd1306_emu_frame.data++;
+
+	switch(mode)
+	{
+		case MODE_HORIZONTAL:
+		if(col++>=col_end){
+			col=col_start;
+			page=page>=page_end?page_start:page+1;
+		}
+		break;
+
+		case MODE_VERTICAL:
+		if(page++>=page_end){
+			page=page_start;
+			col=col>=col_end?col_start:col+1;
+		}
+		break;
+
+		default:
+		col=col>=127?col_start:col+1;
+		break;
+	}
+}
+
+//================================================================================================================================
+//	output
+//================================================================================================================================
+
+/** A1 + C8 (the usual init) shows RAM column 0, row 0 top left*/
+uint8_t ssd1306_emu_pixel(uint8_t x, uint8_t y)
+{
+	uint8_t c=seg_remap?x:127-x;
+	uint8_t r=((com_dec?y:63-y)+start_line+offset)&63;
+	uint8_t on=(ram[r>>3][c]>>(r&7))&1;
+
+	if(!display_on) return 0;
+	if(all_on) on=1;
+	return on^invert;
+}
+
+int ssd1306_emu_write_pbm(const char *path)
+{
+	FILE *f=fopen(path,"wb");
+	uint8_t x,y;
+
+	if(!f) return -1;
+	fprintf(f,"P1\n128 64\n");
+	for(y=0;y<64;y++)
+	{
+		for(x=0;x<128;x++) fputc('0'+ssd1306_emu_pixel(x,y),f);
+		fputc('\n',f);
+	}
+	return fclose(f);
+}
+
+static void add(ssd1306_emu_stats_t *to, const ssd1306_emu_stats_t *from)
+{
+	to->transactions+=from->transactions;
+	to->starts+=from->starts;
+	to->bytes+=from->bytes;
+	to->data+=from->data;
+	to->bus_us+=from->bus_us;
+}
+
+static void end_frame(void)
+{
+	ssd1306_emu_stats_t *s=&ssd1306_emu_frame;
+
+	if(!s->starts) return;
+	s->bus_us=(uint32_t)(((uint64_t)9*s->bytes+2*s->starts)*1000/scl_khz);
+	if(stats)
+	fprintf(stderr,"frame %u: %u transactions, %u starts, %u bytes (%u data), %u us at %u kHz\n",
+	ssd1306_emu_frames,s->transactions,s->starts,s->bytes,s->data,s->bus_us,scl_khz);
+	if(pbm && strchr(pbm,'%')){
+		char name[256];
+		snprintf(name,sizeof(name),pbm,ssd1306_emu_frames);
+		ssd1306_emu_write_pbm(name);
+	}
+	add(&ssd1306_emu_total,s);
+	memset(s,0,sizeof(*s));
+	ssd1306_emu_frames++;
+}
+
+static void sink(uint8_t event, uint8_t b)
+{
+	switch(event)
+	{
+		case HAL_TWI_START:
+		if(!in_xfer && hal_host_cycles-last_stop>=SSD1306_EMU_GAP) end_frame();
+		first=1;
+		in_xfer=0;
+		break;
+
+		case HAL_TWI_BYTE:
+		if(first){
+			first=0;
+			in_xfer=(b&0xFE)==hal_host_twi_addr && !(b&1);
+			if(in_xfer){
+				ssd1306_emu_frame.starts++;
+				ssd1306_emu_frame.bytes++;
+				ctrl_next=1;
+			}
+			break;
+		}
+		if(!in_xfer) break;
+		ssd1306_emu_frame.bytes++;
+		if(ctrl_next){
+			single=(b&0x80)!=0;		/* Co */
+			is_data=(b&0x40)!=0;	/* D/C# */
+			ctrl_next=0;
+			break;
+		}
+		if(is_data) data(b);
+		else command(b);
+		if(single) ctrl_next=1;
+		break;
+
+		case HAL_TWI_STOP:
+		if(in_xfer){
+			ssd1306_emu_frame.transactions++;
+			last_stop=hal_host_cycles;
+		}
+		in_xfer=0;
+		break;
+	}
+}
+
+static void finish(void)
+{
+	ssd1306_emu_stats_t *t=&ssd1306_emu_total;
+
+	end_frame();
+	if(stats)
+	fprintf(stderr,"total %u frames: %u transactions, %u starts, %u bytes (%u data), %u us at %u kHz\n",
+	ssd1306_emu_frames,t->transactions,t->starts,t->bytes,t->data,t->bus_us,scl_khz);
+	if(pbm && !strchr(pbm,'%')) ssd1306_emu_write_pbm(pbm);
+}
+
+__attribute__((constructor)) static void ssd1306_emu_start(void)
+{
+	const char *s=getenv("EMU_SCL_KHZ");
+
+	if(s && atoi(s)>0) scl_khz=atoi(s);
+	s=getenv("EMU_STATS");
+	stats=s && *s=='1';
+	pbm=getenv("EMU_PBM");
+	hal_host_twi_sink=sink;
+	atexit(finish);
+}
+
+#endif /* HAL_HOST */
@@ -0,0 +1,40 @@
+/*
+ * ssd1306_emu.h
+ * host side model of the SSD1306 (-DHAL_HOST only), fed from hal_host_twi_sink
+ *
+ * decodes the control byte / command / data stream to 0x78 into GDDRAM with page,
+ * horizontal and vertical addressing, COLUMNADDR/PAGEADDR windows, SEGREMAP,
+ * COMSCANDEC, start line, display offset, invert and display on/off.
+ * a frame is a burst of transactions, closed by SSD1306_EMU_GAP of bus silence.
+ *
+ * environment:
+ *   EMU_SCL_KHZ   SCL rate for the bus time estimate (default 400)
+ *   EMU_STATS     1 = one line per frame on stderr, a summary at exit
+ *   EMU_PBM       file for the panel image at exit; with a %u in the name
+ *                 (e.g. frame%04u.pbm) every frame is written
+ */
+
+
+#ifndef SSD1306_EMU_H_
+#define SSD1306_EMU_H_
+
+#include <stdint.h>
+
+#define SSD1306_EMU_GAP		(F_CPU/1000)	/* 1 ms of idle bus ends a frame */
+
+typedef struct {
+	uint32_t transactions;	/* START ... STOP to the display */
+	uint32_t starts;		/* START and repeated START */
+	uint32_t bytes;			/* address, control, command and data bytes */
+	uint32_t data;			/* bytes that went into GDDRAM */
+	uint32_t bus_us;		/* estimated at EMU_SCL_KHZ: 9 clocks a byte, 1 per START/STOP */
+} ssd1306_emu_stats_t;
+
+extern ssd1306_emu_stats_t ssd1306_emu_frame;	/* frame in progress */
+extern ssd1306_emu_stats_t ssd1306_emu_total;
+extern uint32_t ssd1306_emu_frames;
+
+uint8_t ssd1306_emu_pixel(uint8_t x, uint8_t y);	/* 1 = lit, as seen on the panel */
+int ssd1306_emu_write_pbm(const char *path);		/* 0 or -1 */
+
+#endif /* SSD1306_EMU_H_ */
@@ -0,0 +1,259 @@
+/*
+ * uart.c
+ * USART0 with a transmit ring buffer drained by the data register empty interrupt.
+ * uart_write() only copies into the ring, the ISR feeds UDR0 one byte per character time.
+ * The receive side is a single producer (USART0_RX_vect) single consumer (main loop) ring,
+ * lines are put together by uart_read_line() outside the interrupt. A line that fills
+ * the whole ring without a line end is thrown away, up to and including its line end.
+ */
+#include "uart.h"
+#include "hal.h"
+#include "prof.h"
+#include "fmt.h"
+
+static volatile char uart_tx_buf[UART_TX_SIZE];
+static volatile uint8_t uart_tx_head;	/* next free slot, written by uart_write() */
+static volatile uint8_t uart_tx_tail;	/* next byte to send, written by the ISR */
+static volatile uint8_t uart_tx_sent;	/* a byte went to UDR0 since the last uart_flush() */
+static uart_tx_policy_t uart_tx_policy=UART_TX_DEFAULT_POLICY;
+
+static volatile char uart_rx_buf[UART_RX_SIZE];
+static volatile uint8_t uart_rx_head;	/* written by the ISR only */
+static volatile uint8_t uart_rx_tail;	/* written by the main loop only */
+static volatile uint8_t uart_rx_lines;	/* line ends in the ring */
+static volatile uint8_t uart_rx_lost;
+static volatile uint8_t uart_rx_cut;	/* set by the ISR: the ring is full of one unfinished line */
+static uint8_t uart_rx_skip;			/* main loop: dropping the rest of that line */
+
+/** UART Initialization, double speed, 8N1, RX and TX interrupts*/
+void uart_init(unsigned int ubrr) {
+	hal_uart_init(ubrr); // Double speed, 8N1, RX, TX and RX complete interrupt
+}
+
+/** Change the baud rate, after everything queued at the old one has gone out*/
+void uart_set_ubrr(unsigned int ubrr)
+{
+	uart_flush();
+	hal_uart_baud(ubrr);
+}
+
+void uart_set_tx_policy(uart_tx_policy_t policy)
+{
+	uart_tx_policy=policy;
+}
+
+/** USART0 data register empty, send the next queued byte or switch the interrupt off.
+* TXC0 is cleared with every byte so it only gets set after the last one (uart_flush)*/
+ISR(USART0_UDRE_vect)
+{
+	PROF_SCOPE(PROF_ISR_UDRE);
+	uint8_t tail=uart_tx_tail;
+	if(tail==uart_tx_head){
+		hal_uart_tx_irq(0);
+		return;
+	}
+	hal_uart_put(uart_tx_buf[tail]);
+	uart_tx_sent=1;
+	uart_tx_tail=(tail+1)&(UART_TX_SIZE-1);
+}
+
+uint8_t uart_tx_free(void)
+{
+	return (UART_TX_SIZE-1)-((uart_tx_head-uart_tx_tail)&(UART_TX_SIZE-1));
+}
+
+/** with interrupts off (before sei() or inside an ISR) nobody drains the ring, do it by hand*/
+static void uart_tx_poll(void)
+{
+	hal_spin();
+	if(!hal_irq_enabled() && hal_uart_tx_ready() && uart_tx_head!=uart_tx_tail){
+		hal_uart_put(uart_tx_buf[uart_tx_tail]);
+		uart_tx_sent=1;
+		uart_tx_tail=(uart_tx_tail+1)&(UART_TX_SIZE-1);
+	}
+}
+
+/** Queue len bytes for sending. Never waits unless the policy is UART_TX_BLOCK and the
+* ring is full. Returns how many bytes were queued.*/
+uint16_t uart_write(const char *data, uint16_t len)
+{
+	uint16_t n;
+	uint8_t head;
+
+	if(len>uart_tx_free()){
+		if(uart_tx_policy==UART_TX_DROP) return 0;
+		if(uart_tx_policy==UART_TX_TRUNCATE) len=uart_tx_free();
+	}
+	head=uart_tx_head;
+	for(n=0;n<len;n++)
+	{
+		if(((head+1)&(UART_TX_SIZE-1))==uart_tx_tail){	/* only UART_TX_BLOCK gets here */
+			PROF_START(t);
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+			{
+				uart_tx_head=head;	/* publish what we have so the ISR can drain it */
+				hal_uart_tx_irq(1);
+			}
+			while(((head+1)&(UART_TX_SIZE-1))==uart_tx_tail)
+			uart_tx_poll();
+			PROF_STOP(PROF_TX_WAIT,t);
+		}
+		uart_tx_buf[head]=data[n];
+		head=(head+1)&(UART_TX_SIZE-1);
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uart_tx_head=head;
+		if(len) hal_uart_tx_irq(1);
+	}
+	return len;
+}
+
+uint16_t uart_puts(const char *str)
+{
+	const char *end=str;
+	while(*end) end++;
+	return uart_write(str,end-str);
+}
+
+/** wait until everything queued has left the pin, e.g. before changing the baud rate*/
+void uart_flush(void)
+{
+	PROF_START(t);
+	while(uart_tx_head!=uart_tx_tail)
+	uart_tx_poll();
+	if(uart_tx_sent)
+	while(!hal_uart_tx_done())	/* last stop bit sent */
+	hal_spin();
+	uart_tx_sent=0;
+	PROF_STOP(PROF_TX_WAIT,t);
+}
+
+/** uart_puts() for a string in flash, copied in small pieces so it never needs
+* a RAM copy of its own*/
+uint16_t uart_puts_P(const char *str)
+{
+	char buf[16];
+	uint16_t sent=0;
+	uint8_t n;
+
+	do{
+		for(n=0;n<sizeof(buf) && (buf[n]=pgm_read_byte(str))!='\0';n++) str++;
+		sent+=uart_write(buf,n);
+	}while(n==sizeof(buf));
+	return sent;
+}
+
+// Send a single character over UART
+void uart_send(char data) {
+	uart_write(&data,1);
+}
+
+void uart_send_string(const char* str) {
+	uart_puts(str); // Send string
+}
+
+/** numbers in the UART reports, without pulling in vfprintf*/
+void uart_put_u32(uint32_t v)
+{
+	char digits[10];
+	uart_write(digits,fmt_u32(digits,v)-digits);
+}
+
+//interrupt service routine for UART RX
+static void uart_rx_count_lost(void)
+{
+	if(uart_rx_lost<255) uart_rx_lost++;
+}
+
+/** store the byte and count line ends, a full ring drops the byte. Full without a
+* line end in it, nothing would ever read the ring again: flag the line for removal*/
+ISR(USART0_RX_vect)
+{
+	PROF_SCOPE(PROF_ISR_RX);
+	char received=hal_uart_get();
+	uint8_t head=uart_rx_head;
+	uint8_t next=(head+1)&(UART_RX_SIZE-1);
+
+	if(next==uart_rx_tail){
+		uart_rx_count_lost();
+		if(!uart_rx_lines) uart_rx_cut=1;
+		return;
+	}
+	uart_rx_buf[head]=received;
+	uart_rx_head=next;
+	if(received=='\r' || received=='\n') uart_rx_lines++;
+}
+
+int16_t uart_getc(void)
+{
+	uint8_t tail=uart_rx_tail;
+	char c;
+
+	if(tail==uart_rx_head) return -1;
+	c=uart_rx_buf[tail];
+	uart_rx_tail=(tail+1)&(UART_RX_SIZE-1);
+	if(c=='\r' || c=='\n'){
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			uart_rx_lines--;
+		}
+	}
+	return (uint8_t)c;
+}
+
+uint8_t uart_rx_available(void)
+{
+	return (uart_rx_head-uart_rx_tail)&(UART_RX_SIZE-1);
+}
+
+/** a cut line counts, uart_read_line() has to remove it*/
+uint8_t uart_lines_pending(void)
+{
+	return uart_rx_lines+uart_rx_cut;
+}
+
+uint8_t uart_rx_overruns(void)
+{
+	return uart_rx_lost;
+}
+
+/** Take the next complete line out of the ring. Empty lines (the "\n" of "\r\n")
+* are skipped and characters beyond size-1 are dropped. A line cut by a full ring
+* is dropped up to its line end, which may still be on the way, and counted in
+* uart_rx_overruns(). Returns the length of the '\0' terminated line, 0 when no
+* complete line is waiting.*/
+uint8_t uart_read_line(char *line, uint8_t size)
+{
+	uint8_t len;
+	int16_t c;
+
+	if(uart_rx_cut){
+		uart_rx_cut=0;
+		uart_rx_skip=1;
+	}
+	while(uart_rx_skip)
+	{
+		if((c=uart_getc())<0) return 0;
+		if(c=='\r' || c=='\n'){
+			uart_rx_skip=0;
+		}else{
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+			{
+				uart_rx_count_lost();
+			}
+		}
+	}
+
+	while(uart_rx_lines)
+	{
+		len=0;
+		while((c=uart_getc())!='\r' && c!='\n' && c>=0)
+		{
+			if(len<size-1) line[len++]=c;
+		}
+		line[len]='\0';
+		if(len) return len;
+	}
+	return 0;
+}
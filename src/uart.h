@@ -0,0 +1,43 @@
+/*
+ * uart.h
+ * interrupt driven USART0 driver, replies are queued in a ring buffer
+ * and sent by USART0_UDRE_vect so the main loop never waits on the baud rate.
+ * Received bytes go into a second ring so several commands can be waiting at once.
+ */
+
+
+#ifndef UART_H_
+#define UART_H_
+
+#include <stdint.h>
+
+#define UART_TX_SIZE	128		/* bytes in the transmit ring, power of 2 */
+#define UART_RX_SIZE	128		/* bytes in the receive ring, power of 2 */
+
+/** what uart_write() does when the message does not fit in the ring*/
+typedef enum {
+	UART_TX_DROP,				/* queue nothing, return 0 */
+	UART_TX_BLOCK,				/* wait for the ISR to make room, always queues everything */
+	UART_TX_TRUNCATE			/* queue what fits, drop the rest */
+} uart_tx_policy_t;
+#define UART_TX_DEFAULT_POLICY	UART_TX_BLOCK
+
+void uart_init(unsigned int ubrr);
+void uart_set_ubrr(unsigned int ubrr);	/* flushes, then switches the baud rate */
+void uart_set_tx_policy(uart_tx_policy_t policy);
+uint16_t uart_write(const char *data, uint16_t len);	/* returns the number of bytes queued */
+uint16_t uart_puts(const char *str);
+uint16_t uart_puts_P(const char *str);	/* string in flash, uart_puts_P(PSTR("...")) */
+uint8_t uart_tx_free(void);			/* room left in the ring */
+void uart_flush(void);				/* wait until the ring and the shift register are empty */
+void uart_send(char data);			/* single char, same policy as uart_write() */
+void uart_send_string(const char* str);
+void uart_put_u32(uint32_t v);		/* decimal, no padding, through fmt_u32() */
+
+int16_t uart_getc(void);			/* next received byte or -1 */
+uint8_t uart_rx_available(void);	/* received bytes waiting */
+uint8_t uart_lines_pending(void);	/* complete lines ('\r' or '\n' seen) or a cut one waiting */
+uint8_t uart_read_line(char *line, uint8_t size);	/* returns the length, 0 if no complete line */
+uint8_t uart_rx_overruns(void);		/* bytes lost to a full ring or a cut line, saturates at 255 */
+
+#endif /* UART_H_ */
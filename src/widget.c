@@ -0,0 +1,103 @@
+/*
+ * widget.c
+ * numeric fields on top of the text functions of ssd1306.c, a bar written as raw columns
+ */
+#include <string.h>
+#include "hal.h"
+#include "ssd1306.h"
+#include "fmt.h"
+#include "widget.h"
+
+void widget_text(const char *text, uint8_t row, uint8_t col)
+{
+#ifdef SSD1306_FRAMEBUFFER
+	ssd1306_fb_str((char *)text,row,col);
+#else
+	sendStrXY((char *)text,row,col);
+#endif
+}
+
+void widget_text_P(const char *text, uint8_t row, uint8_t col)
+{
+	char buf[WIDGET_TEXT_MAX+1];
+
+	strncpy_P(buf,text,WIDGET_TEXT_MAX);
+	buf[WIDGET_TEXT_MAX]='\0';
+	widget_text(buf,row,col);
+}
+
+/** Format the value and compare it with what the field shows. Without the framebuffer
+* each run of changed characters is one position command and one data transaction,
+* a value that moves by one usually costs a single glyph.*/
+void field_draw(field_t *f, uint16_t value)
+{
+	char text[FIELD_MAX+1];
+	uint8_t i=0,first;
+
+	fmt_u16(text,value,f->width);
+	while(i<f->width)
+	{
+		if(text[i]==f->shown[i]){
+			i++;
+			continue;
+		}
+		first=i;
+		while(i<f->width && text[i]!=f->shown[i])
+		{
+			f->shown[i]=text[i];
+			i++;
+		}
+		char c=text[i];		/* terminate the run in place */
+		text[i]='\0';
+		widget_text(&text[first],f->row,f->col+first);
+		text[i]=c;
+	}
+}
+
+void field_invalidate(field_t *f)
+{
+	memset(f->shown,0,sizeof(f->shown));
+}
+
+/** Move the edge of the bar to level columns (0..width). Only the columns between the
+* old and the new edge are written, as one fill. Inverting, e.g. to blink, rewrites the
+* filled part with its bits flipped, still a single fill without a framebuffer.*/
+void bar_draw(bar_t *b, uint8_t level, uint8_t inverted)
+{
+	uint8_t from,to,fill;
+
+	if(level>b->width) level=b->width;
+	fill=inverted?(uint8_t)~BAR_FILL:BAR_FILL;
+	if(inverted!=b->inverted){
+		from=0;
+		to=level>b->shown?level:b->shown;
+	}else if(level>b->shown){
+		from=b->shown;
+		to=level;
+	}else{
+		from=level;
+		to=b->shown;
+	}
+	b->shown=level;
+	b->inverted=inverted;
+	if(from==to) return;
+
+	/* from <= level <= to: filled up to level, empty after it */
+#ifdef SSD1306_FRAMEBUFFER
+	uint8_t *dst=&ssd1306_buffer[b->page*SSD1306_LCDWIDTH+b->x];
+	memset(&dst[from],fill,level-from);
+	memset(&dst[level],BAR_EMPTY,to-level);
+#else
+	ssd1306_window(b->x+from,b->page,to-from,1);
+	ssd1306_data_begin();
+	if(level>from) ssd1306_data_fill(fill,level-from);
+	if(to>level) ssd1306_data_fill(BAR_EMPTY,to-level);
+	ssd1306_data_end();
+#endif
+}
+
+void bar_invalidate(bar_t *b)
+{
+	b->shown=0;
+	b->inverted=0;
+}
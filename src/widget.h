@@ -0,0 +1,44 @@
+/*
+ * widget.h
+ * display elements that remember what they put on the screen and only send changes.
+ * cells are ROW 0-7 and COL 0-15 like sendStrXY(). with SSD1306_FRAMEBUFFER they
+ * draw into the back frame and the caller flushes, otherwise they go to the display.
+ */
+
+
+#ifndef WIDGET_H_
+#define WIDGET_H_
+
+#include <stdint.h>
+
+#define FIELD_MAX		5		/* digits of a uint16_t */
+#define WIDGET_TEXT_MAX	32		/* characters of a widget_text_P() label, two rows */
+
+/** number at a fixed cell, right aligned*/
+typedef struct {
+	uint8_t row, col;
+	uint8_t width;				/* characters, up to FIELD_MAX */
+	char shown[FIELD_MAX];		/* characters on the display, 0 = unknown */
+} field_t;
+
+void field_draw(field_t *f, uint16_t value);	/* only the digits that changed go out */
+void field_invalidate(field_t *f);				/* after the display was cleared */
+
+#define BAR_FILL		0x7E	/* column byte of the filled part, a pixel free above and below */
+#define BAR_EMPTY		0x00
+
+/** horizontal bar in one page, one pixel column per step*/
+typedef struct {
+	uint8_t page;
+	uint8_t x, width;			/* columns */
+	uint8_t shown;				/* filled columns on the display */
+	uint8_t inverted;			/* the filled part is shown inverted */
+} bar_t;
+
+void bar_draw(bar_t *b, uint8_t level, uint8_t inverted);	/* only the columns that changed go out */
+void bar_invalidate(bar_t *b);			/* after the display was cleared */
+
+void widget_text(const char *text, uint8_t row, uint8_t col);	/* static labels */
+void widget_text_P(const char *text, uint8_t row, uint8_t col);	/* label in flash, up to WIDGET_TEXT_MAX */
+
+#endif /* WIDGET_H_ */
@@ -0,0 +1,82 @@
+/*
+ * golden_status.h
+ * status screen after boot with the inputs at 512: PWM 127, duty 50 %, MIN 0, MAX 255
+ * one string per pixel row, # = lit. test_status_screen_matches_golden prints the
+ * rows that differ; check the new image and paste them here when the change is wanted
+ */
+
+#ifndef GOLDEN_STATUS_H_
+#define GOLDEN_STATUS_H_
+
+/* worst display frame in bytes after the input steps from 512 to 700: PWM 127 -> 174,
+ * duty 50 -> 68 % and 23 bar columns took 80 bytes in 6 transactions */
+#define FRAME_BUDGET_INPUT	96
+
+static const char *const golden_status[SSD1306_LCDHEIGHT]={
+	".####....#...#...#...#.............................#......###.....###...........................................................",
+	".#...#...#...#...##.##....##......................##.....#...#...#...#..........................................................",
+	".#...#...#...#...#.#.#....##.......................#.........#...#...#..........................................................",
+	".####....#.#.#...#.#.#.............................#.......##.....###...........................................................",
+	".#.......#.#.#...#...#....##.......................#......#......#...#..........................................................",
+	".#.......#.#.#...#...#....##.......................#.....#.......#...#..........................................................",
+	".#........#.#....#...#............................###....#####....###...........................................................",
+	"................................................................................................................................",
+	".###..............#......................................#####....###....##.....................................................",
+	".#..#.............#...............##.....................#.......#...#...##..#..................................................",
+	".#...#...#..#....###.....#..#.....##.....................####....#..##......#...................................................",
+	".#...#...#..#.....#......#..#................................#...#.#.#.....#....................................................",
+	".#...#...#..#.....#......#..#.....##.........................#...##..#....#.....................................................",
+	".#..#....#..#.....#.......###.....##.....................#...#...#...#...#..##..................................................",
+	".###......###.....##........#.............................###.....###.......##..................................................",
+	"..........................##....................................................................................................",
+	"................................................................................................................................",
+	"################################################################................................................................",
+	"################################################################................................................................",
+	"################################################################................................................................",
+	"################################################################................................................................",
+	"################################################################................................................................",
+	"################################################################................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	".#...#....#.......................................###............#...#............................###....#####...#####..........",
+	".##.##....................##.....................#...#...........##.##....................##.....#...#...#.......#..............",
+	".#.#.#....#......#.##.....##.....................#..##...........#.#.#....###....#...#....##.........#...####....####...........",
+	".#.#.#....#......##.#............................#.#.#...........#.#.#.......#....#.#..............##........#.......#..........",
+	".#...#....#......#..#.....##.....................##..#...........#...#....####.....#......##......#..........#.......#..........",
+	".#...#....#......#..#.....##.....................#...#...........#...#...#...#....#.#.....##.....#.......#...#...#...#..........",
+	".#...#....#......#..#.............................###............#...#....####...#...#...........#####....###.....###...........",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+	"................................................................................................................................",
+};
+
+#endif /* GOLDEN_STATUS_H_ */
@@ -0,0 +1,648 @@
+/*
+ * test_main.c
+ * firmware tests on the host simulator: pio test -e native
+ *
+ * the whole firmware is booted once through app_init() and then runs under the
+ * scheduler for a given simulated time, see run_ms(). UART output is collected in
+ * tx_log, the panel is read back from the SSD1306 model. the tests run in order
+ * and each one starts from the state the previous one left.
+ */
+#include <unity.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "sched.h"
+#include "uart.h"
+#include "widget.h"
+#include "ssd1306.h"
+#include "ssd1306_emu.h"
+#include "I2C.h"
+#include "pid.h"
+#include "curve.h"
+#include "capture.h"
+#include "adc_filter.h"
+#include "proto.h"
+#include "fmt.h"
+#include "golden_status.h"
+
+void app_init(void);
+extern uint8_t blink_phase;
+uint8_t stage_curve(uint8_t type, uint8_t gamma10);
+extern volatile uint16_t pwm_value;
+
+static jmp_buf idle_exit;
+static uint64_t run_end;
+static char tx_log[4096];
+static uint16_t tx_len;
+
+static void tx_sink(uint8_t data)
+{
+	if(tx_len<sizeof(tx_log)-1) tx_log[tx_len++]=data;
+	tx_log[tx_len]=0;
+}
+
+/** leaves sched_run() at the first idle sleep after run_end, no task is half done there*/
+static void idle_hook(void)
+{
+	if(hal_host_cycles>=run_end) longjmp(idle_exit,1);
+}
+
+static void run_ms(uint32_t ms)
+{
+	run_end=hal_host_cycles+(uint64_t)ms*(F_CPU/1000);
+	if(!setjmp(idle_exit)){
+		sei();
+		sched_run();
+	}
+}
+
+/** offset of n bytes in tx_log at or after from, or -1. tx_log may hold binary data*/
+static int16_t tx_find_bytes(const void *data, uint16_t n, uint16_t from)
+{
+	for(;from+n<=tx_len;from++) if(!memcmp(tx_log+from,data,n)) return from;
+	return -1;
+}
+
+static int16_t tx_find(const char *text, uint16_t from)
+{
+	return tx_find_bytes(text,strlen(text),from);
+}
+
+static uint8_t tx_count(const char *text)
+{
+	uint8_t n=0;
+	int16_t at=-1;
+	while((at=tx_find(text,at+1))>=0) n++;
+	return n;
+}
+
+static void send(const char *text)
+{
+	tx_len=0;
+	tx_log[0]=0;
+	hal_host_uart_input(text,strlen(text));
+}
+
+/** bytes the display got so far, the frame in progress included*/
+static uint32_t bus_bytes(void)
+{
+	return ssd1306_emu_total.bytes+ssd1306_emu_frame.bytes;
+}
+
+static uint32_t bus_data(void)
+{
+	return ssd1306_emu_total.data+ssd1306_emu_frame.data;
+}
+
+/** send the back frame and wait until it is on the panel, for widget tests outside the scheduler*/
+static void flush_now(void)
+{
+	while(!ssd1306_flush()) I2C_Wait();
+	I2C_Wait();
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+//================================================================================================================================
+//	status screen
+//================================================================================================================================
+
+static void test_status_screen_matches_golden(void)
+{
+	char row[SSD1306_LCDWIDTH+1];
+	uint8_t x, y, bad=0;
+
+	for(y=0;y<SSD1306_LCDHEIGHT;y++)
+	{
+		for(x=0;x<SSD1306_LCDWIDTH;x++) row[x]=ssd1306_emu_pixel(x,y)?'#':'.';
+		row[x]=0;
+		if(strcmp(row,golden_status[y])){
+			printf("row %2u: %s\n",y,row);	/* the new image, to review and paste */
+			bad++;
+		}
+	}
+	TEST_ASSERT_EQUAL_UINT8_MESSAGE(0,bad,"status screen differs from golden_status.h");
+}
+
+/** an unchanged screen sends nothing, whatever the refresh rate*/
+static void test_idle_frames_send_nothing(void)
+{
+	uint32_t before=bus_bytes();
+
+	run_ms(500);
+	TEST_ASSERT_EQUAL_UINT32(before,bus_bytes());
+}
+
+/** a new input level only resends the digits and bar columns that changed*/
+static void test_input_change_frame_budget(void)
+{
+	uint32_t frames=ssd1306_emu_frames;
+	uint32_t worst=0;
+	uint16_t ms;
+
+	hal_host_adc[0]=700;
+	for(ms=0;ms<200;ms++)
+	{
+		run_ms(1);
+		/* the frame in progress before the change is left from the boot */
+		if(ssd1306_emu_frames!=frames && ssd1306_emu_frame.bytes>worst) worst=ssd1306_emu_frame.bytes;
+	}
+	TEST_ASSERT_EQUAL_UINT16(700,pwm_value);
+	TEST_ASSERT_GREATER_THAN_UINT32(frames,ssd1306_emu_frames);
+	TEST_ASSERT_LESS_OR_EQUAL_UINT32(FRAME_BUDGET_INPUT,worst);
+	hal_host_adc[0]=512;
+	run_ms(200);
+}
+
+//================================================================================================================================
+//	widgets
+//================================================================================================================================
+
+static void test_field_sends_changed_digits_only(void)
+{
+	field_t f={ .row=4, .col=2, .width=3 };
+	uint32_t before;
+
+	field_draw(&f,123);
+	flush_now();
+	before=bus_data();
+	field_draw(&f,123);
+	flush_now();
+	TEST_ASSERT_EQUAL_UINT32(before,bus_data());
+
+	field_draw(&f,124);				/* one character, at most its 8 columns */
+	flush_now();
+	TEST_ASSERT_GREATER_THAN_UINT32(before,bus_data());
+	TEST_ASSERT_LESS_OR_EQUAL_UINT32(before+8,bus_data());
+
+	before=bus_data();
+	field_draw(&f,7);				/* "  7", all three change */
+	flush_now();
+	TEST_ASSERT_GREATER_THAN_UINT32(before+2*8,bus_data());
+	TEST_ASSERT_LESS_OR_EQUAL_UINT32(before+3*8,bus_data());
+}
+
+static void test_bar_sends_changed_columns_only(void)
+{
+	bar_t b={ .page=5, .x=0, .width=SSD1306_LCDWIDTH };
+	uint32_t before;
+
+	bar_draw(&b,20,0);
+	flush_now();
+	TEST_ASSERT_TRUE(ssd1306_emu_pixel(19,5*8+1));
+	TEST_ASSERT_FALSE(ssd1306_emu_pixel(20,5*8+1));
+
+	before=bus_data();
+	bar_draw(&b,30,0);
+	flush_now();
+	TEST_ASSERT_EQUAL_UINT32(before+10,bus_data());
+	TEST_ASSERT_TRUE(ssd1306_emu_pixel(29,5*8+1));
+
+	before=bus_data();
+	bar_draw(&b,25,0);
+	flush_now();
+	TEST_ASSERT_EQUAL_UINT32(before+5,bus_data());
+	TEST_ASSERT_FALSE(ssd1306_emu_pixel(25,5*8+1));
+}
+
+/** report numbers: no padding, no leading zeros, the full 32-bit range*/
+static void test_fmt_u32_edges(void)
+{
+	static const uint32_t v[]={ 0, 7, 10, 1000000000UL, 4294967295UL };
+	static const char *const want[]={ "0", "7", "10", "1000000000", "4294967295" };
+	char buf[11];
+	uint8_t i;
+
+	for(i=0;i<5;i++)
+	{
+		*fmt_u32(buf,v[i])=0;
+		TEST_ASSERT_EQUAL_STRING(want[i],buf);
+	}
+}
+
+//================================================================================================================================
+//	UART lines
+//================================================================================================================================
+
+static void test_uart_lines_back_to_back(void)
+{
+	send("MIN:10\r\nMAX:200\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Temp MIN stored"));
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Temp MAX stored"));
+}
+
+/** a line longer than the ring is dropped and counted, the next line still works*/
+static void test_uart_overlong_line_recovers(void)
+{
+	static char junk[1001];
+	uint8_t lost=uart_rx_overruns();
+
+	memset(junk,'x',sizeof(junk)-1);
+	send(junk);
+	hal_host_uart_input("\r\nMIN:20\r\n",10);
+	run_ms(1000);
+	TEST_ASSERT_GREATER_THAN_UINT8(lost,uart_rx_overruns());
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Temp MIN stored"));
+}
+
+//================================================================================================================================
+//	PID
+//================================================================================================================================
+
+/* the loop takes the 12-bit filter output */
+#define Y(code)	((code)*4)
+
+static void pid_reset(int16_t kp, int16_t ki, int16_t kd)
+{
+	pid.on=0;
+	pid.sp_ch=PID_SP_FIXED;
+	pid.sp=600;
+	pid.out_min=0;
+	pid.out_max=1023;
+	pid.integ=(int32_t)500<<PID_Q;		/* holding 500 */
+	pid.fresh=1;
+	pid_set_gains(kp,ki,kd);
+}
+
+static void test_pid_proportional_step(void)
+{
+	pid_reset(256,0,0);					/* kp 1.0 */
+	TEST_ASSERT_EQUAL_UINT16(600,pid_step(Y(500)));	/* 500 + 1.0 * 100 */
+	TEST_ASSERT_EQUAL_UINT16(500,pid_step(Y(600)));	/* no error, the integral holds */
+}
+
+static void test_pid_integral_accumulates(void)
+{
+	pid_reset(0,128,0);					/* ki 0.5 */
+	TEST_ASSERT_EQUAL_UINT16(550,pid_step(Y(500)));
+	TEST_ASSERT_EQUAL_UINT16(600,pid_step(Y(500)));
+}
+
+static void test_pid_derivative_on_measurement(void)
+{
+	pid_reset(0,0,256);
+	TEST_ASSERT_EQUAL_UINT16(500,pid_step(Y(500)));	/* first step, no kick */
+	TEST_ASSERT_EQUAL_UINT16(490,pid_step(Y(510)));	/* y rose by 10 */
+	pid.sp=900;
+	TEST_ASSERT_EQUAL_UINT16(500,pid_step(Y(510)));	/* setpoint step, still no kick */
+}
+
+/** a quarter code of feedback from the filter still moves the output*/
+static void test_pid_uses_12_bit_feedback(void)
+{
+	pid_reset(512,0,0);					/* kp 2.0 */
+	TEST_ASSERT_EQUAL_UINT16(700,pid_step(Y(500)));
+	TEST_ASSERT_EQUAL_UINT16(699,pid_step(Y(500)+2));
+}
+
+/** while the output is saturated the integral stops*/
+static void test_pid_anti_windup(void)
+{
+	uint16_t i;
+
+	pid_reset(256,64,0);
+	pid.out_max=800;
+	for(i=0;i<1000;i++) TEST_ASSERT_EQUAL_UINT16(800,pid_step(Y(0)));
+	TEST_ASSERT_EQUAL_INT32((int32_t)500<<PID_Q,pid.integ);
+	/* back on the setpoint the output is where it was, a wound up integral would hold it at 800 */
+	TEST_ASSERT_EQUAL_UINT16(500,pid_step(Y(600)));
+}
+
+/** a gain command cut short is refused, no character past the end is looked at*/
+static void test_pid_short_gain_command(void)
+{
+	send("PID:K\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Error"));
+	send("PID:KP=\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Error"));
+}
+
+//================================================================================================================================
+//	curve
+//================================================================================================================================
+
+/** where the curve is steeper than 1, the 12-bit input gives finer output steps*/
+static void test_curve_takes_12_bit_input(void)
+{
+	curve_build(CURVE_GAMMA,50,0,255);
+	TEST_ASSERT_TRUE(curve_map(4088)<curve_map(4089));
+	TEST_ASSERT_TRUE(curve_map(4089)<curve_map(4090));
+	TEST_ASSERT_EQUAL_UINT16(1023,curve_map(4092));
+	curve_build(CURVE_LINEAR,22,0,255);
+	TEST_ASSERT_EQUAL_UINT16(512,curve_map(2048));
+	TEST_ASSERT_EQUAL_UINT16(1023,curve_map(4092));
+}
+
+/** the log curve rises steeply in the first table span, it has an entry per code there*/
+static void test_curve_log_near_zero(void)
+{
+	curve_build(CURVE_LOG,0,0,255);
+	TEST_ASSERT_EQUAL_UINT16(0,curve_map(0));
+	TEST_ASSERT_UINT16_WITHIN(1,102,curve_map(Y(1)));	/* 1023 * log2(x + 1) / 10 */
+	TEST_ASSERT_UINT16_WITHIN(1,205,curve_map(Y(3)));
+	TEST_ASSERT_UINT16_WITHIN(1,324,curve_map(Y(8)));
+	TEST_ASSERT_UINT16_WITHIN(9,347,curve_map(Y(10)));
+	curve_build(CURVE_LINEAR,0,0,255);
+}
+
+/** a gamma out of 10..50 is refused as text and as a binary frame, also when it wraps in a byte*/
+static void test_curve_gamma_range(void)
+{
+	send("CURVE:GAM300\r\n");			/* 300 & 0xFF = 44 */
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Error"));
+	send("CURVE:GAM5\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Error"));
+	TEST_ASSERT_NOT_EQUAL(0,stage_curve(CURVE_GAMMA,CURVE_GAMMA_MIN-1));
+	TEST_ASSERT_NOT_EQUAL(0,stage_curve(CURVE_GAMMA,CURVE_GAMMA_MAX+1));
+}
+
+//================================================================================================================================
+//	ADC filter
+//================================================================================================================================
+
+/** outputs of the filter for a step from 0 to 1000 after two zeros, 12-bit*/
+static uint8_t filter_step(uint16_t *out, uint8_t n)
+{
+	uint8_t i, got=0;
+
+	for(i=0;i<n;i++)
+	if(filter_run(i<2?0:1000,&out[got])) got++;
+	return got;
+}
+
+/** the IIR starts at its input and climbs to the step without overshoot*/
+static void test_filter_iir_step_response(void)
+{
+	uint16_t out[40];
+	uint8_t i;
+
+	filter_set(FILTER_IIR,2,0);				/* 1/4 of the error per sample */
+	TEST_ASSERT_EQUAL_UINT8(40,filter_step(out,40));
+	TEST_ASSERT_EQUAL_UINT16(0,out[1]);
+	TEST_ASSERT_EQUAL_UINT16(1000,out[2]);	/* a quarter of 4000 */
+	TEST_ASSERT_EQUAL_UINT16(1750,out[3]);
+	for(i=3;i<40;i++) TEST_ASSERT_TRUE(out[i]>=out[i-1] && out[i]<=4000);
+	TEST_ASSERT_UINT16_WITHIN(4,4000,out[39]);
+	filter_set(FILTER_OFF,0,0);
+}
+
+/** median of three: a one sample spike is gone, a step comes through one sample late*/
+static void test_filter_median_step_and_spike(void)
+{
+	static const uint16_t in[]={ 100,100,900,100,100,900,900,900 };
+	static const uint16_t want[]={ 100,100,100,100,100,100,900,900 };
+	uint16_t out;
+	uint8_t i;
+
+	filter_set(FILTER_OFF,0,1);
+	for(i=0;i<sizeof(in)/sizeof(in[0]);i++)
+	{
+		TEST_ASSERT_EQUAL_UINT8(1,filter_run(in[i],&out));
+		TEST_ASSERT_EQUAL_UINT16(want[i]*4,out);
+	}
+	filter_set(FILTER_OFF,0,0);
+}
+
+/** oversampling 4^k samples gives one output with k extra bits*/
+static void test_filter_oversample_block(void)
+{
+	uint16_t out[8];
+
+	filter_set(FILTER_OVERSAMPLE,1,0);		/* the sum of 4 samples is already 12-bit */
+	TEST_ASSERT_EQUAL_UINT8(3,filter_step(out,12));
+	TEST_ASSERT_EQUAL_UINT16(0+0+1000+1000,out[0]);
+	TEST_ASSERT_EQUAL_UINT16(4000,out[1]);
+	filter_set(FILTER_OFF,0,0);
+}
+
+//================================================================================================================================
+//	ADC
+//================================================================================================================================
+
+/** every channel in the scan list is converted and reported*/
+static void test_scan_reports_each_channel(void)
+{
+	hal_host_adc[3]=77;
+	send("SCAN:0,3\r\n");
+	run_ms(100);
+	send("ADC\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"ADC0=512 ADC3=77"));
+	TEST_ASSERT_EQUAL_UINT16(512,pwm_value);
+	send("SCAN:0\r\n");
+	run_ms(100);
+}
+
+/** the auto trigger needs a fresh TOV1 edge after a quiet read, or the scan stops for good*/
+static void test_scan_resumes_after_quiet_read(void)
+{
+	hal_host_adc[1]=321;
+	send("ADC:NR=1\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"ADC1=321 (quiet)"));
+
+	hal_host_adc[0]=300;
+	run_ms(100);
+	TEST_ASSERT_EQUAL_UINT16(300,pwm_value);
+	hal_host_adc[0]=512;
+	run_ms(100);
+	TEST_ASSERT_EQUAL_UINT16(512,pwm_value);
+}
+
+//================================================================================================================================
+//	capture
+//================================================================================================================================
+
+/** the dump goes out in steps, the scheduler still sleeps between them and a command waits for the end*/
+static void test_capture_dump_does_not_block(void)
+{
+	uint32_t worst=0;
+	int16_t at, end;
+	uint16_t ms;
+
+	send("CAP:NOW\r\n");
+	for(ms=0;ms<250;ms++)			/* full after 96 records, 12 ms */
+	{
+		uint64_t t=hal_host_cycles;
+		run_ms(1);
+		if(hal_host_cycles-t>worst) worst=hal_host_cycles-t;
+		if(ms==50) hal_host_uart_input("ADC\r\n",5);
+	}
+	TEST_ASSERT_LESS_THAN_UINT32(2*(F_CPU/1000),worst);
+	TEST_ASSERT_EQUAL_UINT8(CAP_IDLE,capture.state);
+	at=tx_find("CAP: dump at 250000 baud",0);
+	TEST_ASSERT_TRUE(at>=0);
+
+	/* header, 96 records and the CRC, the reply only after them */
+	at=tx_find("CAP",at+4);
+	TEST_ASSERT_TRUE(at>=0);
+	TEST_ASSERT_EQUAL_UINT16(96,(uint8_t)tx_log[at+3]|(uint8_t)tx_log[at+4]<<8);
+	end=at+9+96*4+1;
+	TEST_ASSERT_EQUAL_INT(end,tx_find("Got: ADC",at));
+}
+
+/** a trigger level outside 0..1023 is refused, not wrapped into 16 bits*/
+static void test_capture_level_range(void)
+{
+	send("CAP:RISE=-5\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Error"));
+	send("CAP:FALL=1024\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"Error"));
+	TEST_ASSERT_EQUAL_UINT8(CAP_IDLE,capture.state);
+	TEST_ASSERT_NOT_EQUAL(0,capture_arm(CAP_TRIG_RISE,1024,1,0));
+}
+
+//================================================================================================================================
+//	binary protocol
+//================================================================================================================================
+
+static void send_frame(uint8_t op, uint8_t bad_crc)
+{
+	uint8_t f[4]={ PROTO_SYNC, op, 0, 0 };
+
+	f[3]=proto_crc8(0,&f[1],2)^(bad_crc?0x5A:0);
+	tx_len=0;
+	hal_host_uart_input((const char *)f,4);
+}
+
+/** a frame with a wrong CRC gets a NACK and changes nothing, the next good one is answered*/
+static void test_proto_rejects_bad_crc(void)
+{
+	uint8_t nack[6]={ PROTO_SYNC, PROTO_NACK, 2, PROTO_OP_PING, PROTO_ERR_CRC, 0 };
+	uint8_t ack[4]={ PROTO_SYNC, PROTO_OP_PING|PROTO_ACK, 0, 0 };
+
+	nack[5]=proto_crc8(0,&nack[1],4);
+	ack[3]=proto_crc8(0,&ack[1],2);
+
+	send("BIN\r\n");
+	run_ms(100);
+	send_frame(PROTO_OP_PING,1);
+	run_ms(20);
+	TEST_ASSERT_EQUAL_UINT16(sizeof(nack),tx_len);
+	TEST_ASSERT_EQUAL_INT(0,tx_find_bytes(nack,sizeof(nack),0));
+
+	send_frame(PROTO_OP_PING,0);
+	run_ms(20);
+	TEST_ASSERT_EQUAL_UINT16(sizeof(ack),tx_len);
+	TEST_ASSERT_EQUAL_INT(0,tx_find_bytes(ack,sizeof(ack),0));
+
+	send_frame(PROTO_OP_TEXT,0);			/* back to text for the next tests */
+	run_ms(20);
+	send("ADC\r\n");
+	run_ms(100);
+	TEST_ASSERT_NOT_NULL(strstr(tx_log,"ADC0="));
+}
+
+//================================================================================================================================
+//	scheduler
+//================================================================================================================================
+
+/** periodic tasks keep their period, and the ms clock keeps step with the CPU clock*/
+static void test_sched_period_timing(void)
+{
+	uint64_t start=hal_host_cycles;
+	uint16_t ms0=sched_now(), last=0, i;
+	uint8_t phase=blink_phase, flips=0;
+
+	for(i=0;i<2000;i++)
+	{
+		run_ms(1);
+		if(blink_phase!=phase){
+			uint16_t now=sched_now();
+			if(flips) TEST_ASSERT_UINT16_WITHIN(1,250,now-last);	/* BLINK_MS in main.c */
+			last=now;
+			phase=blink_phase;
+			flips++;
+		}
+	}
+	TEST_ASSERT_EQUAL_UINT8(8,flips);
+	TEST_ASSERT_UINT16_WITHIN(1,(hal_host_cycles-start)/(F_CPU/1000),(uint16_t)(sched_now()-ms0));
+}
+
+//================================================================================================================================
+//	button
+//================================================================================================================================
+
+/** contact chatter shorter than the debounce window gives no event, a held press gives one*/
+static void test_button_bounce_train(void)
+{
+	uint8_t i;
+
+	send("MIN:0\r\n");					/* something to apply, the same as now */
+	run_ms(100);
+	tx_len=0;
+	tx_log[0]=0;
+	for(i=0;i<10;i++)						/* 1 to 4 ms pulses, each one bouncing too */
+	{
+		hal_host_button_hold(1+i%4);
+		run_ms(3+i%4);
+	}
+	run_ms(100);
+	TEST_ASSERT_NULL(strstr(tx_log,"MIN/MAX updated"));
+
+	hal_host_button_hold(100);				/* bounces on both edges */
+	run_ms(300);
+	TEST_ASSERT_EQUAL_UINT8(1,tx_count("MIN/MAX updated via button press"));
+
+	send("MIN:0\r\n");
+	run_ms(100);
+	hal_host_button_hold(1000);				/* long press discards */
+	run_ms(1200);
+	TEST_ASSERT_EQUAL_UINT8(1,tx_count("Pending values discarded"));
+	TEST_ASSERT_EQUAL_UINT8(0,tx_count("MIN/MAX updated"));
+}
+
+int main(void)
+{
+	hal_host_stdin=0;
+	hal_host_uart_sink=tx_sink;
+	hal_host_idle_hook=idle_hook;
+	hal_host_end=UINT64_MAX;
+
+	app_init();
+	run_ms(1000);				/* banner out, the first frames drawn */
+
+	UNITY_BEGIN();
+	RUN_TEST(test_status_screen_matches_golden);
+	RUN_TEST(test_idle_frames_send_nothing);
+	RUN_TEST(test_input_change_frame_budget);
+	RUN_TEST(test_field_sends_changed_digits_only);
+	RUN_TEST(test_bar_sends_changed_columns_only);
+	RUN_TEST(test_fmt_u32_edges);
+	RUN_TEST(test_uart_lines_back_to_back);
+	RUN_TEST(test_uart_overlong_line_recovers);
+	RUN_TEST(test_pid_proportional_step);
+	RUN_TEST(test_pid_integral_accumulates);
+	RUN_TEST(test_pid_derivative_on_measurement);
+	RUN_TEST(test_pid_uses_12_bit_feedback);
+	RUN_TEST(test_pid_anti_windup);
+	RUN_TEST(test_pid_short_gain_command);
+	RUN_TEST(test_curve_takes_12_bit_input);
+	RUN_TEST(test_curve_log_near_zero);
+	RUN_TEST(test_curve_gamma_range);
+	RUN_TEST(test_filter_iir_step_response);
+	RUN_TEST(test_filter_median_step_and_spike);
+	RUN_TEST(test_filter_oversample_block);
+	RUN_TEST(test_scan_resumes_after_quiet_read);
+	RUN_TEST(test_scan_reports_each_channel);
+	RUN_TEST(test_capture_dump_does_not_block);
+	RUN_TEST(test_capture_level_range);
+	RUN_TEST(test_proto_rejects_bad_crc);
+	RUN_TEST(test_sched_period_timing);
+	RUN_TEST(test_button_bounce_train);
+	return UNITY_END();
+}
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""
+check_ram.py
+fails the build when the static SRAM use (.data + .bss + .noinit, from avr-size -A)
+leaves less than a stack reserve below RAMEND
+
+  PlatformIO:  extra_scripts = post:tools/check_ram.py   (runs after the ELF is linked)
+  by hand:     tools/check_ram.py firmware.elf [mcu]     (mcu defaults to atmega2560)
+
+the reserve covers the deepest main loop call chain plus nested ISRs; raise it
+when a new task keeps large buffers on the stack.
+"""
+
+import subprocess
+import sys
+
+# mcu: (RAMSTART, RAMEND, stack reserve in bytes)
+MCUS = {
+    "atmega2560": (0x0200, 0x21FF, 1024),
+    "atmega328p": (0x0100, 0x08FF, 384),
+}
+
+SECTIONS = (".data", ".bss", ".noinit")
+
+
+def ram_used(size_output):
+    """sum of the RAM sections in avr-size -A output"""
+    used = {}
+    for line in size_output.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0] in SECTIONS and parts[1].isdigit():
+            used[parts[0]] = int(parts[1])
+    return used
+
+
+def check(elf, mcu, size_tool="avr-size"):
+    """0 when the image fits, 1 when it does not, with a one line summary on stdout"""
+    if mcu not in MCUS:
+        print("check_ram: unknown mcu %s" % mcu)
+        return 1
+    start, end, reserve = MCUS[mcu]
+    ram = end - start + 1
+    out = subprocess.run([size_tool, "-A", elf], check=True, capture_output=True, text=True).stdout
+    used = ram_used(out)
+    total = sum(used.values())
+    detail = " ".join("%s=%d" % (s, used.get(s, 0)) for s in SECTIONS)
+    print("check_ram: %s %d of %d bytes static (%s), %d left for the stack, %d reserved"
+          % (mcu, total, ram, detail, ram - total, reserve))
+    if total + reserve > ram:
+        print("check_ram: static SRAM exceeds RAMEND - stack reserve by %d bytes" % (total + reserve - ram))
+        return 1
+    return 0
+
+
+try:
+    Import("env")  # noqa: F821, only defined inside PlatformIO
+
+    def _post_elf(target, source, env):
+        if check(str(target[0]), env.BoardConfig().get("build.mcu"), env.subst("$SIZETOOL") or "avr-size"):
+            env.Exit(1)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", _post_elf)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        if len(sys.argv) < 2:
+            print("usage: check_ram.py firmware.elf [mcu]")
+            sys.exit(2)
+        sys.exit(check(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else "atmega2560"))
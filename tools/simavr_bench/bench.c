@@ -0,0 +1,371 @@
+/*
+ * bench.c
+ * runs the firmware ELF under simavr and prints cycle figures as JSON
+ *
+ *   ISRs     cycles from vector entry to RETI, and latency from the flag being
+ *            raised to the vector starting, for ADC, USART0_RX, USART0_UDRE, TIMER1_OVF,
+ *            TIMER0_COMPA (1 ms tick) and TWI
+ *   funcs    update_display() (one run of the display task), process_uart_command()
+ *            and pid_step() (one PID loop step, run for 200 ms after the e2e part with
+ *            PID:ON), from the call to the matching return, interrupts included
+ *   filters  ADC_vect cycles for each FILT: mode, 100 ms each after the e2e part. the
+ *            difference to "OFF" is what the filter stage in adc_filter.h costs
+ *   e2e      "MAX:100\r" typed on USART0, button clicked (50 ms) on PE4 once the reply
+ *            is in, until OCR1A holds the new clamp value. a click applies on release,
+ *            so button_to_ocr1a includes the 50 ms and the debounce time
+ *
+ * the ADC0 input sits at AVcc so the output runs into MAX, an SSD1306 at 0x3C acks
+ * everything on the TWI. usage: bench firmware.elf [warmup_ms]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <gelf.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_irq.h>
+#include <simavr/sim_interrupts.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_adc.h>
+#include <simavr/avr_twi.h>
+
+#define F_CPU		16000000UL
+#define MS			(F_CPU/1000)
+#define OCR1A		0x88		/* data space address, ATmega2560 */
+#define OLED_ADDR	0x3C
+
+typedef struct {
+	const char *name;
+	uint64_t count, sum, min, max;
+} stat_t;
+
+static void stat_add(stat_t *s, uint64_t v)
+{
+	if(!s->count || v<s->min) s->min=v;
+	if(v>s->max) s->max=v;
+	s->sum+=v;
+	s->count++;
+}
+
+static void stat_json(const stat_t *s, const char *tail)
+{
+	if(!s->count){
+		printf("    \"%s\": null%s\n",s->name,tail);
+		return;
+	}
+	printf("    \"%s\": {\"count\": %llu, \"min\": %llu, \"max\": %llu, \"mean\": %llu}%s\n",s->name,
+	(unsigned long long)s->count,(unsigned long long)s->min,(unsigned long long)s->max,
+	(unsigned long long)(s->sum/s->count),tail);
+}
+
+static avr_t *avr;
+
+//================================================================================================================================
+//	interrupts
+//================================================================================================================================
+
+/* ATmega2560 vector numbers, data sheet table 14-1 minus one (avr-libc *_vect_num) */
+typedef struct {
+	uint8_t vector;
+	uint64_t raised;
+	stat_t run, latency;
+	uint64_t entered;
+} isr_t;
+
+static stat_t *adc_mode;		/* ADC_vect runs also go here during the filter sweep */
+
+static isr_t isrs[]={
+	{ 29, 0, { "ADC_vect" }, { "ADC_vect" } },
+	{ 25, 0, { "USART0_RX_vect" }, { "USART0_RX_vect" } },
+	{ 26, 0, { "USART0_UDRE_vect" }, { "USART0_UDRE_vect" } },
+	{ 20, 0, { "TIMER1_OVF_vect" }, { "TIMER1_OVF_vect" } },
+	{ 21, 0, { "TIMER0_COMPA_vect" }, { "TIMER0_COMPA_vect" } },
+	{ 39, 0, { "TWI_vect" }, { "TWI_vect" } },
+};
+#define ISR_COUNT	(sizeof(isrs)/sizeof(isrs[0]))
+
+static void pending_hook(avr_irq_t *irq, uint32_t value, void *param)
+{
+	isr_t *i=param;
+	if(value && !i->raised) i->raised=avr->cycle;
+}
+
+static void running_hook(avr_irq_t *irq, uint32_t value, void *param)
+{
+	isr_t *i=param;
+	if(value){
+		i->entered=avr->cycle;
+		if(i->raised) stat_add(&i->latency,avr->cycle-i->raised);
+		i->raised=0;
+	}else if(i->entered){
+		stat_add(&i->run,avr->cycle-i->entered);
+		if(i==&isrs[0] && adc_mode) stat_add(adc_mode,avr->cycle-i->entered);
+		i->entered=0;
+	}
+}
+
+static void hook_vectors(void)
+{
+	for(int v=0;v<avr->interrupts.vector_count;v++)
+	{
+		avr_int_vector_t *vec=avr->interrupts.vector[v];
+		for(unsigned n=0;n<ISR_COUNT;n++)
+		{
+			if(vec->vector!=isrs[n].vector) continue;
+			avr_irq_register_notify(vec->irq+AVR_INT_IRQ_PENDING,pending_hook,&isrs[n]);
+			avr_irq_register_notify(vec->irq+AVR_INT_IRQ_RUNNING,running_hook,&isrs[n]);
+		}
+	}
+}
+
+//================================================================================================================================
+//	functions, timed by PC and stack pointer
+//================================================================================================================================
+
+typedef struct {
+	const char *symbol;
+	uint32_t addr;
+	uint16_t sp;			/* stack pointer at entry, 0 = not inside */
+	uint64_t entered;
+	stat_t run;
+} func_t;
+
+static func_t funcs[]={
+	{ "update_display", 0, 0, 0, { "update_display" } },
+	{ "process_uart_command", 0, 0, 0, { "process_uart_command" } },
+	{ "pid_step", 0, 0, 0, { "pid_step" } },
+};
+#define FUNC_COUNT	(sizeof(funcs)/sizeof(funcs[0]))
+
+static uint16_t sp_get(void)
+{
+	return avr->data[R_SPL]|(avr->data[R_SPH]<<8);
+}
+
+/** byte address of a function from the ELF symbol table, 0 if missing*/
+static uint32_t symbol(const char *path, const char *name)
+{
+	uint32_t addr=0;
+	int fd=open(path,O_RDONLY);
+	Elf *elf;
+	Elf_Scn *scn=NULL;
+
+	if(fd<0) return 0;
+	elf_version(EV_CURRENT);
+	elf=elf_begin(fd,ELF_C_READ,NULL);
+	while(elf && !addr && (scn=elf_nextscn(elf,scn))!=NULL)
+	{
+		GElf_Shdr sh;
+		Elf_Data *data;
+		gelf_getshdr(scn,&sh);
+		if(sh.sh_type!=SHT_SYMTAB) continue;
+		data=elf_getdata(scn,NULL);
+		for(size_t i=0;i<sh.sh_size/sh.sh_entsize;i++)
+		{
+			GElf_Sym sym;
+			gelf_getsym(data,i,&sym);
+			if(GELF_ST_TYPE(sym.st_info)==STT_FUNC && !strcmp(elf_strptr(elf,sh.sh_link,sym.st_name),name)){
+				addr=sym.st_value;
+				break;
+			}
+		}
+	}
+	if(elf) elf_end(elf);
+	close(fd);
+	return addr;
+}
+
+static void track_funcs(void)
+{
+	for(unsigned n=0;n<FUNC_COUNT;n++)
+	{
+		func_t *f=&funcs[n];
+		if(!f->addr) continue;
+		if(!f->sp && avr->pc==f->addr){
+			f->sp=sp_get();
+			f->entered=avr->cycle;
+		}else if(f->sp && sp_get()>f->sp){	/* return address popped */
+			stat_add(&f->run,avr->cycle-f->entered);
+			f->sp=0;
+		}
+	}
+}
+
+/* FILT: commands of the sweep, the stat names are the JSON keys */
+static const char *const filter_cmds[]={
+	"FILT:OFF\r", "FILT:OFF,MED\r", "FILT:OS1\r", "FILT:OS3\r", "FILT:OS3,MED\r",
+	"FILT:IIR1\r", "FILT:IIR6\r", "FILT:IIR6,MED\r",
+};
+#define FILTER_COUNT	(sizeof(filter_cmds)/sizeof(filter_cmds[0]))
+static stat_t filters[FILTER_COUNT]={
+	{ "OFF" }, { "OFF,MED" }, { "OS1" }, { "OS3" }, { "OS3,MED" },
+	{ "IIR1" }, { "IIR6" }, { "IIR6,MED" },
+};
+
+//================================================================================================================================
+//	peripherals around the chip
+//================================================================================================================================
+
+static char uart_out[512];
+static size_t uart_len;
+static avr_irq_t *twi_in;
+static uint8_t oled_selected;
+
+static void uart_out_hook(avr_irq_t *irq, uint32_t value, void *param)
+{
+	if(uart_len<sizeof(uart_out)-1){
+		uart_out[uart_len++]=value;
+		uart_out[uart_len]=0;
+	}else{		/* keep the tail, the bench only looks for recent replies */
+		memmove(uart_out,uart_out+256,uart_len-256);
+		uart_len-=256;
+	}
+}
+
+/** minimal SSD1306: ack our address and every byte written to it*/
+static void twi_hook(avr_irq_t *irq, uint32_t value, void *param)
+{
+	avr_twi_msg_irq_t v;
+	v.u.v=value;
+	if(v.u.twi.msg&TWI_COND_STOP) oled_selected=0;
+	if(v.u.twi.msg&TWI_COND_ADDR){
+		oled_selected=(v.u.twi.addr>>1)==OLED_ADDR && !(v.u.twi.addr&1);
+		if(oled_selected) avr_raise_irq(twi_in,avr_twi_irq_msg(TWI_COND_ACK,v.u.twi.addr,1));
+	}
+	if((v.u.twi.msg&TWI_COND_WRITE) && oled_selected)
+	avr_raise_irq(twi_in,avr_twi_irq_msg(TWI_COND_ACK,v.u.twi.addr,1));
+}
+
+static int step(void)
+{
+	int state=avr_run(avr);
+	track_funcs();
+	return state!=cpu_Done && state!=cpu_Crashed;
+}
+
+/** run until text shows up on the UART or the time runs out, returns the cycle or 0*/
+static uint64_t run_until_text(const char *text, uint64_t limit)
+{
+	uint64_t end=avr->cycle+limit;
+	while(avr->cycle<end && step())
+	{
+		if(strstr(uart_out,text)) return avr->cycle;
+	}
+	return 0;
+}
+
+static void run_for(uint64_t cycles)
+{
+	uint64_t end=avr->cycle+cycles;
+	while(avr->cycle<end && step());
+}
+
+static uint16_t ocr1a(void)
+{
+	return avr->data[OCR1A]|(avr->data[OCR1A+1]<<8);
+}
+
+int main(int argc, char *argv[])
+{
+	elf_firmware_t fw;
+	avr_irq_t *uart_in, *button;
+	uint64_t warmup=(argc>2?atol(argv[2]):500)*MS;
+	uint64_t t_boot, t_typed, t_reply=0, t_press, t_ocr=0;
+	uint32_t flags=0;
+	const char *cmd="MAX:100\r";
+	uint16_t want=(100UL*1023+127)/255;	/* clamp for MAX:100, the input is at full scale */
+
+	if(argc<2){
+		fprintf(stderr,"usage: %s firmware.elf [warmup_ms]\n",argv[0]);
+		return 2;
+	}
+	memset(&fw,0,sizeof(fw));
+	if(elf_read_firmware(argv[1],&fw)){
+		fprintf(stderr,"cannot read %s\n",argv[1]);
+		return 2;
+	}
+	strcpy(fw.mmcu,"atmega2560");
+	fw.frequency=F_CPU;
+	avr=avr_make_mcu_by_name(fw.mmcu);
+	avr_init(avr);
+	avr_load_firmware(avr,&fw);
+	avr->avcc=avr->aref=5000;
+	avr->log=LOG_NONE;
+
+	for(unsigned n=0;n<FUNC_COUNT;n++) funcs[n].addr=symbol(argv[1],funcs[n].symbol);
+	hook_vectors();
+
+	avr_ioctl(avr,AVR_IOCTL_UART_GET_FLAGS('0'),&flags);
+	flags&=~AVR_UART_FLAG_STDIO;
+	avr_ioctl(avr,AVR_IOCTL_UART_SET_FLAGS('0'),&flags);
+	avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_UART_GETIRQ('0'),UART_IRQ_OUTPUT),uart_out_hook,NULL);
+	uart_in=avr_io_getirq(avr,AVR_IOCTL_UART_GETIRQ('0'),UART_IRQ_INPUT);
+
+	twi_in=avr_io_getirq(avr,AVR_IOCTL_TWI_GETIRQ(0),TWI_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_TWI_GETIRQ(0),TWI_IRQ_OUTPUT),twi_hook,NULL);
+
+	avr_raise_irq(avr_io_getirq(avr,AVR_IOCTL_ADC_GETIRQ,ADC_IRQ_ADC0),5000);
+	button=avr_io_getirq(avr,AVR_IOCTL_IOPORT_GETIRQ('E'),4);
+	avr_raise_irq(button,1);			/* released, the pull-up holds PE4 high */
+
+	/* boot until the banner is out, then let the loop settle. the banner starts once
+	* the display is set up and blank */
+	t_boot=run_until_text("Input",3000*MS);
+	if(!run_until_text("OLED I2C",3000*MS)) fprintf(stderr,"no banner\n");
+	run_for(warmup);
+
+	/* end to end: command, reply, button, OCR1A */
+	uart_len=0;
+	uart_out[0]=0;
+	t_typed=avr->cycle;
+	for(const char *c=cmd;*c;c++) avr_raise_irq(uart_in,(uint8_t)*c);
+	t_reply=run_until_text("Temp MAX stored",1000*MS);
+	t_press=avr->cycle;
+	avr_raise_irq(button,0);			/* sampled by the 1 ms tick */
+	run_for(50*MS);
+	avr_raise_irq(button,1);
+	for(uint64_t end=avr->cycle+2000*MS;avr->cycle<end && step();)
+	{
+		if(ocr1a()==want){
+			t_ocr=avr->cycle;
+			break;
+		}
+	}
+
+	/* filter sweep, the reply shows the mode took. back to OFF, the default, at the end */
+	for(unsigned n=0;n<FILTER_COUNT;n++)
+	{
+		uart_len=0;
+		uart_out[0]=0;
+		for(const char *c=filter_cmds[n];*c;c++) avr_raise_irq(uart_in,(uint8_t)*c);
+		if(!run_until_text("\n",1000*MS)) fprintf(stderr,"no reply to %s\n",filter_cmds[n]);
+		adc_mode=&filters[n];
+		run_for(100*MS);
+		adc_mode=NULL;
+	}
+	for(const char *c="FILT:OFF\r";*c;c++) avr_raise_irq(uart_in,(uint8_t)*c);
+	run_for(10*MS);
+
+	/* closed loop: the input at full scale drives the output to MIN */
+	for(const char *c="PID:ON\r";*c;c++) avr_raise_irq(uart_in,(uint8_t)*c);
+	run_for(200*MS);
+
+	printf("{\n  \"f_cpu\": %lu,\n  \"isr_cycles\": {\n",F_CPU);
+	for(unsigned n=0;n<ISR_COUNT;n++) stat_json(&isrs[n].run,n<ISR_COUNT-1?",":"");
+	printf("  },\n  \"isr_latency_cycles\": {\n");
+	for(unsigned n=0;n<ISR_COUNT;n++) stat_json(&isrs[n].latency,n<ISR_COUNT-1?",":"");
+	printf("  },\n  \"adc_filter_cycles\": {\n");
+	for(unsigned n=0;n<FILTER_COUNT;n++) stat_json(&filters[n],n<FILTER_COUNT-1?",":"");
+	printf("  },\n  \"function_cycles\": {\n");
+	for(unsigned n=0;n<FUNC_COUNT;n++) stat_json(&funcs[n].run,n<FUNC_COUNT-1?",":"");
+	printf("  },\n  \"e2e_cycles\": {\n");
+	printf("    \"reset_to_banner\": %llu,\n",(unsigned long long)t_boot);
+	printf("    \"uart_to_reply\": %llu,\n",t_reply?(unsigned long long)(t_reply-t_typed):0ULL);
+	printf("    \"button_to_ocr1a\": %llu,\n",t_ocr?(unsigned long long)(t_ocr-t_press):0ULL);
+	printf("    \"uart_to_ocr1a\": %llu\n",t_ocr?(unsigned long long)(t_ocr-t_typed):0ULL);
+	printf("  }\n}\n");
+	return t_ocr?0:1;
+}
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""
+compare.py
+regression check between two bench outputs:
+
+  compare.py baseline.json bench.json [tolerance_percent]
+
+every cycle figure of the baseline (ISR run time and latency, ADC_vect per filter mode,
+function cycles, end to end times) is compared with the new run. a figure that grew by more
+than the tolerance (default 10 %) fails the check, as does one that went missing
+(null or 0, e.g. a vector that no longer runs). smaller figures are reported only.
+"""
+
+import json
+import sys
+
+GROUPS = ("isr_cycles", "isr_latency_cycles", "adc_filter_cycles", "function_cycles", "e2e_cycles")
+FIELDS = ("min", "mean", "max")
+
+
+def figures(bench):
+    """flat {"group.name.field": cycles} of a bench output"""
+    out = {}
+    for group in GROUPS:
+        for name, value in bench.get(group, {}).items():
+            if isinstance(value, dict):
+                for field in FIELDS:
+                    out["%s.%s.%s" % (group, name, field)] = value.get(field)
+            else:
+                out["%s.%s" % (group, name)] = value
+    return out
+
+
+def compare(base, new, tolerance):
+    """list of (key, old, new, verdict), verdict is "worse", "missing", "better" or "" """
+    rows = []
+    old_f, new_f = figures(base), figures(new)
+    for key in sorted(old_f):
+        old = old_f[key]
+        if not old:
+            continue                    # nothing measured in the baseline
+        cur = new_f.get(key)
+        if not cur:
+            rows.append((key, old, cur, "missing"))
+        elif cur > old * (1 + tolerance / 100.0):
+            rows.append((key, old, cur, "worse"))
+        elif cur < old:
+            rows.append((key, old, cur, "better"))
+        else:
+            rows.append((key, old, cur, ""))
+    return rows
+
+
+def main(argv):
+    if len(argv) < 3:
+        print("usage: compare.py baseline.json bench.json [tolerance_percent]")
+        return 2
+    with open(argv[1]) as f:
+        base = json.load(f)
+    with open(argv[2]) as f:
+        new = json.load(f)
+    tolerance = float(argv[3]) if len(argv) > 3 else 10.0
+    if base.get("f_cpu") != new.get("f_cpu"):
+        print("compare: f_cpu differs, %s against %s" % (base.get("f_cpu"), new.get("f_cpu")))
+        return 1
+
+    failed = 0
+    for key, old, cur, verdict in compare(base, new, tolerance):
+        if verdict in ("worse", "missing"):
+            failed += 1
+        if verdict:
+            print("%-8s %-48s %10s -> %s" % (verdict, key, old, cur))
+    print("compare: %d figure(s) over %g %% or missing" % (failed, tolerance))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))